@@ -198,28 +198,28 @@ class GetData:
     async def get_forecast_df(self) -> None:
         result = self.taos_conn.query(self.fore_SQL)
         data = result.fetch_all_into_dict()
-        f_df[self.iUnit] = pd.DataFrame(data)
+        f_df[self.iUnit] = pd.DataFrame(data).ffill()
         f_df[self.iUnit] += np.random.uniform(0, 0.001, f_df[self.iUnit].shape)
         # print("f_df: ", f_df[self.iUnit].shape)
 
     async def get_anomaly_df(self) -> None:
         result = self.taos_conn.query(self.anom_SQL)  # windows不支持异步查询，适合一行一行立即处理的场景
         data = result.fetch_all_into_dict()
-        a_df[self.iUnit] = pd.DataFrame(data)
+        a_df[self.iUnit] = pd.DataFrame(data).ffill()
         a_df[self.iUnit] += np.random.uniform(0, 0.001, a_df[self.iUnit].shape)  # 以免除数为0和全常数线性相关
         # print("df: ", a_df[self.iUnit].shape)
 
     async def get_anomaly_df_PEM(self) -> None:
         result = self.taos_conn.query(self.anomPEM_SQL)  # windows不支持异步查询，适合一行一行立即处理的场景
         data = result.fetch_all_into_dict()
-        a_df_PEM[self.iUnit] = pd.DataFrame(data)
+        a_df_PEM[self.iUnit] = pd.DataFrame(data).ffill()
         a_df_PEM[self.iUnit] += np.random.uniform(0, 0.001, a_df_PEM[self.iUnit].shape)  # 以免除数为0和全常数线性相关
         # print("df_PEM: ", a_df_PEM[self.iUnit].shape)
 
     async def get_anomaly_df_PG(self) -> None:
         result = self.taos_conn.query(self.anomPG_SQL)  # windows不支持异步查询，适合一行一行立即处理的场景
         data = result.fetch_all_into_dict()
-        a_df_PG[self.iUnit] = pd.DataFrame(data)
+        a_df_PG[self.iUnit] = pd.DataFrame(data).ffill()
         a_df_PG[self.iUnit] += np.random.uniform(0, 0.001, a_df_PG[self.iUnit].shape)  # 以免除数为0和全常数线性相关
         # print("df_PG: ", a_df_PG[self.iUnit].shape)
 
@@ -0,0 +1,124 @@
+#ifndef PACKED_BOOLS_H
+#define PACKED_BOOLS_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Bool columns as the acquisition stores them with bool_storage "packed":
+// column cN is bit 15 - N % 16 of the USMALLINT column w<N / 16> of s_bits.
+// Everything here works on whole words, 16 columns at a time.
+namespace packed {
+
+constexpr const int BITS_PER_WORD { 16 };
+
+inline int word_of(int col)
+{
+    return col / BITS_PER_WORD;
+}
+
+inline uint16_t bit_of(int col)
+{
+    return static_cast<uint16_t>(1u << (BITS_PER_WORD - 1 - col % BITS_PER_WORD));
+}
+
+// "c158" -> 158
+inline int column_index(const std::string& col)
+{
+    return std::stoi(col.substr(1));
+}
+
+inline int popcount(uint16_t v)
+{
+    return __builtin_popcount(v);
+}
+
+// The words a set of bool columns lives in, and which of their bits
+class BitMask {
+public:
+    std::vector<int> words; // ascending
+    std::vector<uint16_t> bits; // per entry of words
+
+    explicit BitMask(const std::vector<std::string>& cols)
+    {
+        for (const auto& col : cols) {
+            const int c { column_index(col) };
+            std::size_t i { 0 };
+            while (i < words.size() && words[i] < word_of(c)) {
+                ++i;
+            }
+            if (i == words.size() || words[i] != word_of(c)) {
+                words.insert(words.begin() + i, word_of(c));
+                bits.insert(bits.begin() + i, 0);
+            }
+            bits[i] |= bit_of(c);
+        }
+    }
+
+    // Word column names to select, e.g. { "w9", "w10" }
+    std::vector<std::string> word_columns() const
+    {
+        std::vector<std::string> names;
+        names.reserve(words.size());
+        for (int w : words) {
+            names.emplace_back("w" + std::to_string(w));
+        }
+        return names;
+    }
+};
+
+// One row of packed words, indexed by word number. Words never set read as 0.
+class PackedRow {
+private:
+    std::vector<uint16_t> m_words;
+
+public:
+    void set_word(int w, uint16_t v)
+    {
+        if (w >= static_cast<int>(m_words.size())) {
+            m_words.resize(w + 1, 0);
+        }
+        m_words[w] = v;
+    }
+
+    uint16_t word(int w) const
+    {
+        return w < static_cast<int>(m_words.size()) ? m_words[w] : 0;
+    }
+
+    bool test(int col) const
+    {
+        return (word(word_of(col)) & bit_of(col)) != 0;
+    }
+
+    // Columns of `mask` that are true
+    int count(const BitMask& mask) const
+    {
+        int n { 0 };
+        for (std::size_t i = 0; i < mask.words.size(); ++i) {
+            n += popcount(word(mask.words[i]) & mask.bits[i]);
+        }
+        return n;
+    }
+
+    // Columns of `mask` that went from false in `prev` to true here
+    int rising_edges(const PackedRow& prev, const BitMask& mask) const
+    {
+        int n { 0 };
+        for (std::size_t i = 0; i < mask.words.size(); ++i) {
+            const int w { mask.words[i] };
+            n += popcount(static_cast<uint16_t>(~prev.word(w) & word(w) & mask.bits[i]));
+        }
+        return n;
+    }
+
+    // Columns of `mask` that went from true in `prev` to false here
+    int falling_edges(const PackedRow& prev, const BitMask& mask) const
+    {
+        return prev.rising_edges(*this, mask);
+    }
+};
+
+} // namespace packed
+
+#endif // PACKED_BOOLS_H
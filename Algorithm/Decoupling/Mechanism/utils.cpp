@@ -3,15 +3,21 @@
 #include <ctime>
 // #include <execution>
 #include <iostream>
+#include <map>
 #include <math.h>
 #include <memory>
+#include <mutex>
 #include <random>
 #include <stdexcept>
 #include <string_view>
 
 #include "dotenv.h"
+#include "latest_frame.h"
+#include "metrics.h"
 #include "nlohmann/json.hpp"
+#include "packed_bools.h"
 #include "taos.h"
+#include "task_metrics.h"
 #include "taskflow/taskflow.hpp"
 #include <mqtt/async_client.h>
 #include <sw/redis++/redis++.h>
@@ -112,6 +118,12 @@ private:
         return opts;
     }
 
+    static MetricCounter& redisErrors()
+    {
+        static MetricCounter& errors { metricCounter("redis_errors") };
+        return errors;
+    }
+
     sw::redis::ConnectionPoolOptions makePoolOptions()
     {
         sw::redis::ConnectionPoolOptions pool_opts;
@@ -137,11 +149,14 @@ public:
 
     std::string m_hget(const std::string& key, const std::string& field)
     {
+        static LatencyHistogram& latency { metricHistogram("redis_hget") };
+        MetricTimer timed { latency };
         std::string res;
         try {
             const auto optional_str = m_redis.hget(key, field);
             res = optional_str.value_or("0");
         } catch (const std::exception& e) {
+            redisErrors().add();
             std::cerr << "Exception: " << e.what() << std::endl;
         }
         return res;
@@ -149,9 +164,12 @@ public:
 
     void m_hset(const std::string_view& hash, const std::string_view& key, const std::string_view& value)
     {
+        static LatencyHistogram& latency { metricHistogram("redis_hset") };
+        MetricTimer timed { latency };
         try {
             m_redis.hset(hash, key, value);
         } catch (const std::exception& e) {
+            redisErrors().add();
             std::cerr << "Exception: " << e.what() << std::endl;
         }
     }
@@ -229,13 +247,18 @@ public:
 
     void publish(const std::string& topic, const std::string& payload, int qos, bool retained = false)
     {
+        static LatencyHistogram& latency { metricHistogram("mqtt_publish") };
+        static MetricCounter& failures { metricCounter("mqtt_publish_failures") };
+        MetricTimer timed { latency };
         auto msg = mqtt::make_message(topic, payload, qos, retained);
         try {
             bool ok = client.publish(msg)->wait_for(TIMEOUT);
             if (!ok) {
+                failures.add();
                 std::cerr << "Error: Publishing message timed out." << std::endl;
             }
         } catch (const mqtt::exception& e) {
+            failures.add();
             std::cerr << "Error: " << e.what() << std::endl;
             connect();
         }
@@ -251,6 +274,68 @@ private:
     uint16_t TAOS_PORT;
     TAOS* taos;
 
+    struct Scale {
+        double scale;
+        double bias;
+    };
+    std::map<std::string, Scale> m_scales {}; // raw s_analog columns, see raw_scale
+
+    LatestFrame m_latest {};
+    bool m_latestOpen { false };
+    std::mutex m_latestLock; // m_latest is shared by the tasks
+
+    // LATEST_SHM=<latest_shm>_<device> in .env when the acquisition runs on
+    // this host with "latest_shm": latest values then come from its shared
+    // memory (latest_frame.h) instead of TDengine, which stays the fallback
+    // while there is no segment. Call with m_latestLock held.
+    const LatestFrame* latest_frame()
+    {
+        static const char* name { std::getenv("LATEST_SHM") };
+        if (name == nullptr) {
+            return nullptr;
+        }
+        if (m_latestOpen && latestReplaced(&m_latest)) {
+            latestClose(&m_latest);
+            m_latestOpen = false;
+        }
+        if (!m_latestOpen) {
+            m_latestOpen = latestOpen(&m_latest, name) == 0;
+        }
+        return m_latestOpen ? &m_latest : nullptr;
+    }
+
+    // Latest values of s_analog (or s_bool) columns `cols` from shared
+    // memory into `vals`; false when they have to come from TDengine
+    bool latest_values(const std::vector<std::string>& cols, bool bools, json& vals)
+    {
+        std::lock_guard<std::mutex> hold { m_latestLock };
+        const LatestFrame* f { latest_frame() };
+        if (f == nullptr) {
+            return false;
+        }
+        std::vector<int> idx {};
+        idx.reserve(cols.size());
+        for (const auto& col : cols) {
+            idx.push_back(packed::column_index(col));
+        }
+        const int n { static_cast<int>(idx.size()) };
+        std::vector<float> analogs(bools ? 0 : n);
+        std::vector<uint8_t> flags(bools ? n : 0);
+        const int64_t millis { bools ? latestRead(f, nullptr, 0, nullptr, idx.data(), n, flags.data())
+                                     : latestRead(f, idx.data(), n, analogs.data(), nullptr, 0, nullptr) };
+        if (millis <= 0) {
+            return false;
+        }
+        for (int i = 0; i < n; ++i) {
+            if (bools) {
+                vals[cols[i]] = flags[i] != 0;
+            } else {
+                vals[cols[i]] = analogs[i];
+            }
+        }
+        return true;
+    }
+
     void connectToTaos()
     {
         taos = taos_connect(TAOS_IP, TAOS_USERNAME, TAOS_PASSWORD, TAOS_DATABASE, TAOS_PORT);
@@ -270,6 +355,7 @@ public:
         TAOS_PORT = static_cast<uint16_t>(std::atoi(std::getenv("TAOS_PORT")));
         connectToTaos();
         puts("Connected to Taos.");
+        load_scales();
     }
 
     MyTaos(const MyTaos&) = delete;
@@ -279,6 +365,9 @@ public:
         
     ~MyTaos() noexcept
     {
+        if (m_latestOpen) {
+            latestClose(&m_latest);
+        }
         if (taos) {
             taos_close(taos);
             taos_cleanup();
@@ -288,6 +377,8 @@ public:
 
     json query(const std::string& sql)
     {
+        static LatencyHistogram& latency { metricHistogram("taos_query") };
+        MetricTimer timed { latency };
         if (taos == nullptr) {
             throw std::runtime_error("Taos connection not initialized");
         }
@@ -316,6 +407,16 @@ public:
                         jsonMsg[std::to_string(rowNum)][fieldName] = *((int32_t*)row[i]);
                         break;
                     }
+                    case TSDB_DATA_TYPE_SMALLINT: // raw INT16 analogs
+                    {
+                        jsonMsg[std::to_string(rowNum)][fieldName] = *((int16_t*)row[i]);
+                        break;
+                    }
+                    case TSDB_DATA_TYPE_USMALLINT: // packed bools, raw UINT16 analogs
+                    {
+                        jsonMsg[std::to_string(rowNum)][fieldName] = *((uint16_t*)row[i]);
+                        break;
+                    }
                     case TSDB_DATA_TYPE_BIGINT: // count(*)
                     {
                         jsonMsg[std::to_string(rowNum)][fieldName] = *((int64_t*)row[i]);
@@ -338,6 +439,11 @@ public:
                         jsonMsg[std::to_string(rowNum)][fieldName] = *((int64_t*)row[i]);
                         break;
                     }
+                    case TSDB_DATA_TYPE_BINARY: {
+                        const int* lengths { taos_fetch_lengths(res) };
+                        jsonMsg[std::to_string(rowNum)][fieldName] = std::string((const char*)row[i], lengths[i]);
+                        break;
+                    }
                     default:
                         break;
                     }
@@ -351,6 +457,8 @@ public:
 
     void execute(const std::string& sql)
     {
+        static LatencyHistogram& latency { metricHistogram("taos_execute") };
+        MetricTimer timed { latency };
         if (taos == nullptr) {
             throw std::runtime_error("Taos connection not initialized");
         }
@@ -380,16 +488,179 @@ public:
         return val;
     }
 
-    std::vector<std::string> query_multi_row(const std::string& key, const std::string& table, int limit)
+    // ANALOG_STORAGE=raw in .env when the acquisition stores 16-bit analogs
+    // unscaled in s_raw (analog_storage "raw"); s_analog keeps the rest
+    static bool analogs_raw()
+    {
+        static const bool raw { std::getenv("ANALOG_STORAGE") != nullptr && std::string(std::getenv("ANALOG_STORAGE")) == "raw" };
+        return raw;
+    }
+
+    // RAW_STABLE in .env when the device's register map has its own
+    // supertables, s_raw<stable>; s_raw by default
+    static const std::string& raw_stable()
+    {
+        static const std::string name { std::getenv("RAW_STABLE") != nullptr ? std::getenv("RAW_STABLE") : "s_raw" };
+        return name;
+    }
+
+    // The s_scale catalog createStable writes for raw_stable(), read once in
+    // the constructor: the register map only changes with a restart, and
+    // the tasks then only read m_scales
+    void load_scales()
+    {
+        if (!analogs_raw()) {
+            return;
+        }
+        json result = query("select col, scale, bias from s_scale where tbl = '" + raw_stable() + "'");
+        for (const auto& item : result.items()) {
+            m_scales[item.value()["col"].get<std::string>()] = { item.value()["scale"].get<double>(), item.value()["bias"].get<double>() };
+        }
+    }
+
+    // Scale of `col` if it is stored in raw_stable()
+    const Scale* raw_scale(const std::string& col) const
+    {
+        const auto it { m_scales.find(col) };
+        return it == m_scales.end() ? nullptr : &it->second;
+    }
+
+    // `expr` over column `col` of s_analog, scaled when `col` is stored raw
+    std::string scaled(const std::string& expr, const std::string& col) const
     {
-        const std::string sql { "select " + key + " from " + table + " limit " + std::to_string(limit) };
+        const Scale* s { raw_scale(col) };
+        if (s == nullptr) {
+            return expr;
+        }
+        char factors[64];
+        snprintf(factors, sizeof(factors), " * %.17g + %.17g", s->scale, s->bias);
+        return expr + factors;
+    }
+
+    // Latest stored value of `col`. The acquisition may store unchanged values
+    // as NULL, and LAST() skips those, i.e. carries the last value forward.
+    template <typename T>
+    T query_last(const std::string& col, const std::string& table)
+    {
+        json latest = json::object();
+        if (table == "s_analog" && latest_values({ col }, false, latest)) {
+            return latest[col].get<T>();
+        }
+        const bool raw { table == "s_analog" && raw_scale(col) != nullptr };
+        const std::string sql { raw ? "select " + scaled("last(" + col + ")", col) + " as " + col + " from " + raw_stable()
+                                    : "select last(" + col + ") as " + col + " from " + table };
+        json result = query(sql);
+        T val {};
+
+        if (result.is_null() || !result["0"].contains(col)) {
+            puts("Taos query return empty");
+        } else {
+            val = result["0"][col];
+        }
+        return val;
+    }
+
+    // BOOL_STORAGE=packed in .env when the acquisition stores bools 16 to a
+    // word in s_bits (bool_storage "packed") instead of one column each
+    static bool bools_packed()
+    {
+        static const bool packed { std::getenv("BOOL_STORAGE") != nullptr && std::string(std::getenv("BOOL_STORAGE")) == "packed" };
+        return packed;
+    }
+
+    // Latest value of each bool column, e.g. { "c158": true }; columns
+    // without a value are left out
+    json last_bools(const std::vector<std::string>& cols)
+    {
+        json latest = json::object();
+        if (latest_values(cols, true, latest)) {
+            return latest;
+        }
+        const std::vector<std::string> names { bools_packed() ? packed::BitMask(cols).word_columns() : cols };
+        std::string sql { "select " };
+        for (std::size_t i = 0; i < names.size(); ++i) {
+            sql += "last(" + names[i] + ") as " + names[i];
+            sql += i != names.size() - 1 ? ", " : " from ";
+        }
+        sql += bools_packed() ? "s_bits" : "s_bool";
+        json result = query(sql);
+        json vals = json::object();
+        if (result.is_null()) {
+            puts("Taos query return empty");
+            return vals;
+        }
+
+        for (const auto& col : cols) {
+            if (!bools_packed()) {
+                if (result["0"].contains(col)) {
+                    vals[col] = result["0"][col] != 0;
+                }
+                continue;
+            }
+            const int c { packed::column_index(col) };
+            const std::string w { "w" + std::to_string(packed::word_of(c)) };
+            if (result["0"].contains(w)) {
+                vals[col] = (result["0"][w].get<uint16_t>() & packed::bit_of(c)) != 0;
+            }
+        }
+        return vals;
+    }
+
+    // Latest value of each s_analog column, e.g. { "c34": 0.98 }; columns
+    // without a value are left out
+    json last_analogs(const std::vector<std::string>& cols)
+    {
+        json latest = json::object();
+        if (latest_values(cols, false, latest)) {
+            return latest;
+        }
+        std::vector<std::string> floats {};
+        std::vector<std::string> raws {};
+        for (const auto& col : cols) {
+            (raw_scale(col) != nullptr ? raws : floats).push_back(col);
+        }
+        json vals = json::object();
+        auto fetch = [&](const std::vector<std::string>& names, const std::string& table) {
+            if (names.empty()) {
+                return;
+            }
+            std::string sql { "select " };
+            for (std::size_t i = 0; i < names.size(); ++i) {
+                sql += scaled("last(" + names[i] + ")", names[i]) + " as " + names[i];
+                sql += i != names.size() - 1 ? ", " : " from ";
+            }
+            json result = query(sql + table);
+            if (result.is_null()) {
+                puts("Taos query return empty");
+                return;
+            }
+            for (const auto& col : names) {
+                if (result["0"].contains(col)) {
+                    vals[col] = result["0"][col];
+                }
+            }
+        };
+        fetch(floats, "s_analog");
+        fetch(raws, raw_stable());
+        return vals;
+    }
+
+    // `key` is fn(col) over supertable `table` with `clause` after it, e.g.
+    // "avg(c1)" over "s_analog" and "interval(1h)"
+    std::vector<std::string> query_multi_row(const std::string& key, const std::string& table, const std::string& clause, int limit)
+    {
+        const std::size_t open { key.find('(') };
+        const std::string col { open == std::string::npos ? "" : key.substr(open + 1, key.size() - open - 2) };
+        const bool raw { table == "s_analog" && raw_scale(col) != nullptr };
+        const std::string sql { "select " + (raw ? scaled(key, col) + " as v" : key) + " from " + (raw ? raw_stable() : table) + " " + clause
+                                + " limit " + std::to_string(limit) };
         json result = query(sql);
         std::vector<std::string> vals {};
         if (result.is_null()) {
             puts("Taos query return empty");
         } else {
             for (const auto& item : result.items()) {
-                std::string val = myRound(item.value()[key]);
+                std::string val = myRound(item.value()[raw ? "v" : key]);
                 vals.emplace_back(val);
             }
         }
@@ -516,21 +787,14 @@ public:
         const std::string key { "H2_" + m_unit + ":Mechanism:H2Quality" };
         const std::string content { "氢气品质差" };
         const std::string now { get_now() };
-        const std::string tableName { "s_analog" };
-        int limit { 1 };
 
-        const std::string sql = generate_select_query(m_cols, tableName, limit);
-        json result = m_taosCli->query(sql);
-        if (result.is_null()) {
-            puts("Taos query return empty");
-            return flag;
-        }
+        json result = m_taosCli->last_analogs(m_cols);
 
         for (const std::string& tag : m_cols) {
             const std::string st = m_redis->m_hget(key, tag);
 
-            if (result["0"][tag] != nullptr) {
-                if (result["0"][tag] < 0.96) {
+            if (result.contains(tag)) {
+                if (result[tag] < 0.96) {
                     trigger(key, tag, tag, content, st, now);
                     flag = 1;
                 } else {
@@ -561,22 +825,15 @@ public:
         const std::string key { "H2_" + m_unit + ":Mechanism:H2Leakage" };
         const std::string content { "发电机漏氢" };
         const std::string now { get_now() };
-        const std::string tableName { "s_bool" };
-        int limit { 1 };
 
-        const std::string sql = generate_select_query(m_cols, tableName, limit);
-        json result = m_taosCli->query(sql);
+        json result = m_taosCli->last_bools(m_cols);
         // std::cout << result.dump(4) << '\n';
-        if (result.is_null()) {
-            puts("Taos query return empty");
-            return flag;
-        }
 
         for (const std::string& tag : m_cols) {
             const std::string st = m_redis->m_hget(key, tag);
 
-            if (result["0"][tag] != nullptr) {
-                if (result["0"][tag] == true) {
+            if (result.contains(tag)) {
+                if (result[tag] == true) {
                     trigger(key, tag, tag, content, st, now);
                     flag = 1;
                 } else {
@@ -607,23 +864,16 @@ public:
         const std::string key { "H2_" + m_unit + ":Mechanism:liquidLeakage" };
         const std::string content { "发电机漏液" };
         const std::string now { get_now() };
-        const std::string tableName { "s_analog" };
-        int limit { 1 };
 
-        const std::string sql = generate_select_query(m_cols, tableName, limit);
-        json result = m_taosCli->query(sql);
+        json result = m_taosCli->last_analogs(m_cols);
         // std::cout << result.dump(4) << '\n';
-        if (result.is_null()) {
-            puts("Taos query return empty");
-            return flag;
-        }
 
         for (std::size_t i = 0; i < m_cols.size(); ++i) {
             const std::string& tag = m_cols[i];
             const std::string st = m_redis->m_hget(key, tag);
 
-            if (result["0"][tag] != nullptr) {
-                if ((i < 4 && result["0"][tag] > 650) || result["0"][tag] > 10) {
+            if (result.contains(tag)) {
+                if ((i < 4 && result[tag] > 650) || result[tag] > 10) {
                     trigger(key, tag, tag, content, st, now);
                     flag = 1;
                 } else {
@@ -712,8 +962,51 @@ public:
         }
     }
 
+    // Packed bools: the same count done here on whole words, rows in which
+    // any of `cols` went from false to true within the last hour
+    long long alert_count_packed(const std::vector<std::string>& cols) const
+    {
+        const packed::BitMask mask { cols };
+        const std::vector<std::string> words { mask.word_columns() };
+        std::string last { "SELECT " };
+        std::string select { "SELECT ts" };
+        for (std::size_t i = 0; i < words.size(); ++i) {
+            last += "LAST(" + words[i] + ") AS " + words[i] + (i != words.size() - 1 ? ", " : "");
+            select += ", " + words[i];
+        }
+
+        // Unchanged words are NULL; carry the previous word forward
+        packed::PackedRow prev;
+        json before = m_taosCli->query(last + " FROM s_bits WHERE ts <= now() - 1h");
+        for (std::size_t i = 0; i < words.size(); ++i) {
+            if (!before.is_null() && before["0"].contains(words[i])) {
+                prev.set_word(mask.words[i], before["0"][words[i]].get<uint16_t>());
+            }
+        }
+
+        long long value { 0 };
+        json rows = m_taosCli->query(select + " FROM s_bits WHERE ts > now() - 1h ORDER BY ts");
+        for (int r = 0; !rows.is_null() && rows.contains(std::to_string(r)); ++r) {
+            const json& row = rows[std::to_string(r)];
+            packed::PackedRow cur { prev };
+            for (std::size_t i = 0; i < words.size(); ++i) {
+                if (row.contains(words[i])) {
+                    cur.set_word(mask.words[i], row[words[i]].get<uint16_t>());
+                }
+            }
+            if (cur.rising_edges(prev, mask) > 0) {
+                ++value;
+            }
+            prev = cur;
+        }
+        return value;
+    }
+
     std::string alert_query(const std::vector<std::string>& cols, const std::string& alias)
     {
+        if (MyTaos::bools_packed()) {
+            return myRound(alert_count_packed(cols));
+        }
         long long value { 0 };
         const std::string sql { generate_alert_stat_sql(cols, alias, tableName) };
         json result = m_taosCli->query(sql);
@@ -784,7 +1077,7 @@ private:
             { "makeH2", "1" },
         };
 
-        double sysStatus { m_taosCli->query_single<double>("c97", "s_analog") };
+        double sysStatus { m_taosCli->query_last<double>("c97", "s_analog") };
         double unitLoad = 960.18;
         std::map<std::string, std::string> status {
             { "unitStatus", "1" },
@@ -793,18 +1086,19 @@ private:
         };
 
         double PEMPower = 1;
-        int PEMSys { m_taosCli->query_single<int>("cast(c159 as int)", "s_bool") };
-        int PGSys { m_taosCli->query_single<int>("cast(c160 as int)", "s_bool") };
+        json sys { m_taosCli->last_bools({ "c159", "c160" }) };
+        int PEMSys { sys.value("c159", false) ? 1 : 0 };
+        int PGSys { sys.value("c160", false) ? 1 : 0 };
         std::map<std::string, std::string> healthLevel {
             { "PEMPower", myRound(PEMPower) + "MW" },
             { "PEMSys", std::to_string(PEMSys) },
             { "PGSys", std::to_string(PGSys) }
         };
 
-        double pressure { m_taosCli->query_single<double>("c1", "s_analog") };
-        double purity { m_taosCli->query_single<double>("c34", "s_analog") };
-        double pew { m_taosCli->query_single<double>("c5", "s_analog") };
-        double makeFlow { m_taosCli->query_single<double>("c201", "s_analog") };
+        double pressure { m_taosCli->query_last<double>("c1", "s_analog") };
+        double purity { m_taosCli->query_last<double>("c34", "s_analog") };
+        double pew { m_taosCli->query_last<double>("c5", "s_analog") };
+        double makeFlow { m_taosCli->query_last<double>("c201", "s_analog") };
         std::map<std::string, std::string> operationData {
             { "pressure", myRound(pressure) + "MPa" },
             { "purity", myRound(purity) + "%" },
@@ -812,10 +1106,10 @@ private:
             { "makeFlow", myRound(makeFlow) + "m3/h" }
         };
 
-        std::vector<std::string> avgPressure { m_taosCli->query_multi_row("avg(c1)", "s_analog interval(1h)", 7) };
-        std::vector<std::string> avgPurity { m_taosCli->query_multi_row("avg(c34)", "s_analog interval(1h)", 7) };
-        std::vector<std::string> avgDew { m_taosCli->query_multi_row("avg(c5)", "s_analog interval(1h)", 7) };
-        std::vector<std::string> avgMakeFlow { m_taosCli->query_multi_row("avg(c201)", "s_analog interval(1h)", 7) };
+        std::vector<std::string> avgPressure { m_taosCli->query_multi_row("avg(c1)", "s_analog", "interval(1h)", 7) };
+        std::vector<std::string> avgPurity { m_taosCli->query_multi_row("avg(c34)", "s_analog", "interval(1h)", 7) };
+        std::vector<std::string> avgDew { m_taosCli->query_multi_row("avg(c5)", "s_analog", "interval(1h)", 7) };
+        std::vector<std::string> avgMakeFlow { m_taosCli->query_multi_row("avg(c201)", "s_analog", "interval(1h)", 7) };
         std::map<std::string, std::vector<std::string>> average {
             { "pressure", avgPressure },
             { "purity", avgPurity },
@@ -945,15 +1239,36 @@ int main()
 
     Task task1(unit1, redisCli, MQTTCli, taosCli);
 
+    // Counters and latencies of metrics.h, written to METRICS_FILE and/or
+    // published on METRICS_TOPIC every METRICS_PERIOD_S seconds (default 60)
+    const std::string METRICS_FILE { std::getenv("METRICS_FILE") ? std::getenv("METRICS_FILE") : "" };
+    const std::string METRICS_TOPIC { std::getenv("METRICS_TOPIC") ? std::getenv("METRICS_TOPIC") : "" };
+    const auto METRICS_PERIOD { std::chrono::seconds(std::getenv("METRICS_PERIOD_S") ? std::atoi(std::getenv("METRICS_PERIOD_S")) : 60) };
+
     tf::Executor executor;
+    executor.make_observer<TaskMetrics>();
+    LatencyHistogram& loopLatency { metricHistogram("loop") };
     long long count { 0 };
     tf::Taskflow f { task1.flow(count) };
+    auto lastExport = std::chrono::steady_clock::now();
 
     while (1) {
         auto start = std::chrono::steady_clock::now();
 
         executor.run(f).wait();
         // executor.run(task2.flow()).wait();
+        loopLatency.record(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+
+        if ((!METRICS_FILE.empty() || !METRICS_TOPIC.empty()) && start - lastExport >= METRICS_PERIOD) {
+            lastExport = start;
+            const std::string text { metricsText() };
+            if (!METRICS_FILE.empty() && !metricsWriteFile(METRICS_FILE, text)) {
+                std::cerr << "Error: Failed to write metrics to " << METRICS_FILE << std::endl;
+            }
+            if (!METRICS_TOPIC.empty()) {
+                MQTTCli->publish(METRICS_TOPIC, text, QOS);
+            }
+        }
 
         auto end = std::chrono::steady_clock::now();
         auto elapsed_time = std::chrono::duration_cast<std::chrono::microseconds>(end - start);
@@ -235,7 +235,7 @@ def forecast_df():
     sql = f"select {cols} from s_analog limit 100"
     result = taos_conn.query(sql)
     data = result.fetch_all_into_dict()
-    f_df = pd.DataFrame(data)
+    f_df = pd.DataFrame(data).ffill()  # 未变化的值存为NULL
     f_df += np.random.uniform(0, 0.001, f_df.shape)
     print("f_df: ", f_df.shape)
 
@@ -247,7 +247,7 @@ def anomaly_df():
     sql = f"select {cols} from s_analog limit 100"
     result = taos_conn.query(sql)  # windows不支持异步查询，适合一行一行立即处理的场景
     data = result.fetch_all_into_dict()
-    df = pd.DataFrame(data)
+    df = pd.DataFrame(data).ffill()  # 未变化的值存为NULL
     df += np.random.uniform(0, 0.001, df.shape)  # 以免除数为0和全常数线性相关
     print("df: ", df.shape)
 
@@ -264,7 +264,7 @@ def anomaly_df_PEM():
     sql = f"select {cols} from s_analog limit 100"
     result = taos_conn.query(sql)  # windows不支持异步查询，适合一行一行立即处理的场景
     data = result.fetch_all_into_dict()
-    df_PEM = pd.DataFrame(data)
+    df_PEM = pd.DataFrame(data).ffill()  # 未变化的值存为NULL
     df_PEM += np.random.uniform(0, 0.001, df_PEM.shape)  # 以免除数为0和全常数线性相关
     print("df_PEM: ", df_PEM.shape)
 
@@ -276,7 +276,7 @@ def anomaly_df_PG():
     sql = f"select {cols} from s_analog limit 100"
     result = taos_conn.query(sql)  # windows不支持异步查询，适合一行一行立即处理的场景
     data = result.fetch_all_into_dict()
-    df_PG = pd.DataFrame(data)
+    df_PG = pd.DataFrame(data).ffill()  # 未变化的值存为NULL
     df_PG += np.random.uniform(0, 0.001, df_PG.shape)  # 以免除数为0和全常数线性相关
     print("df_PG: ", df_PG.shape)
 
@@ -634,7 +634,7 @@ def healthScore():
 
 def H2Quality():
     r1 = json.loads(redis_conn.hget("forecast", "vr"))
-    r2 = taos_conn.query("select c34, c35 from s_analog limit 1").fetch_all()[0]
+    r2 = taos_conn.query("select last(c34), last(c35) from s_analog").fetch_all()[0]
     if r1["c34"][-1] < 0.96 or r1["c35"][-1] < 0.96 or r2[0] < 0.96 or r2[1] < 0.96:
         return 1
     else:
@@ -643,7 +643,7 @@ def H2Quality():
 
 def H2Leakage():
     r1 = json.loads(redis_conn.hget("forecast", "ar1"))
-    r2 = taos_conn.query("select c158, c173 from s_bool limit 1").fetch_all()[0]
+    r2 = taos_conn.query("select last(c158), last(c173) from s_bool").fetch_all()[0]
     if r1["c31"][-1] > 1 or r2[0] == True or r2[1] == True:
         return 1
     else:
@@ -653,7 +653,7 @@ def H2Leakage():
 def liquidLeakage():
     r1 = json.loads(redis_conn.hget("forecast", "vr"))
     r2 = taos_conn.query(
-        "select c36, c37, c38, c39, c27, c28, c29, c30 from s_analog limit 1"
+        "select last(c36), last(c37), last(c38), last(c39), last(c27), last(c28), last(c29), last(c30) from s_analog"
     ).fetch_all()[0]
     if (
         r1["c36"][-1] > 650
@@ -695,7 +695,7 @@ def homeInfo():
         "Status": {
             "unitStatus": "1",
             "sysStatus ": int(
-                taos_conn.query("select c97 from s_analog limit 1").fetch_all()[0][0]
+                taos_conn.query("select last(c97) from s_analog").fetch_all()[0][0]
             ),
             "unitLoad": "960.18MW",
         },
@@ -706,24 +706,24 @@ def homeInfo():
             "liquidLeakage": liquidLeakage(),
             "PEMpower": "制氢功率c138",
             "PEMSys": taos_conn.query(
-                "select cast(c159 as int) from s_bool limit 1"
+                "select cast(last(c159) as int) from s_bool"
             ).fetch_all()[0][0],
             "PGSys": taos_conn.query(
-                "select cast(c160 as int) from s_bool limit 1"
+                "select cast(last(c160) as int) from s_bool"
             ).fetch_all()[0][0],
         },
         "operationData": {
             "pressure": round(
-                taos_conn.query("select c1 from s_analog limit 1").fetch_all()[0][0], 3
+                taos_conn.query("select last(c1) from s_analog").fetch_all()[0][0], 3
             ),
             "purity": round(
-                taos_conn.query("select c34 from s_analog limit 1").fetch_all()[0][0], 3
+                taos_conn.query("select last(c34) from s_analog").fetch_all()[0][0], 3
             ),
             "dew": round(
-                taos_conn.query("select c5 from s_analog limit 1").fetch_all()[0][0], 3
+                taos_conn.query("select last(c5) from s_analog").fetch_all()[0][0], 3
             ),
             "makeFlow": round(
-                taos_conn.query("select c201 from s_analog limit 1").fetch_all()[0][0],
+                taos_conn.query("select last(c201) from s_analog").fetch_all()[0][0],
                 3,
             ),
         },
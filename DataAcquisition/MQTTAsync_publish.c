@@ -19,7 +19,6 @@
 #endif
 
 volatile int connected = 0;
-MQTTAsync_message pubmsg = MQTTAsync_message_initializer;
 MQTTAsync_responseOptions pub_opts = MQTTAsync_responseOptions_initializer;
 
 void connlost(void *context, char *cause)
@@ -161,21 +160,28 @@ void MQTTConn(const char *address, const char *clientid)
 	pub_opts.context = client;
 }
 
-void myPublish(char *value, const char* topic, unsigned int qos)
+void myPublishBytes(const char *payload, int len, const char *topic, unsigned int qos)
 {
-    pubmsg.payload = value;
-	pubmsg.payloadlen = strlen(value);
-	pubmsg.qos = qos;
-	pubmsg.retained = 0;
+	// Own message, as this may run on any thread; the client copies the payload
+	MQTTAsync_message msg = MQTTAsync_message_initializer;
+	msg.payload = (void *)payload;
+	msg.payloadlen = len;
+	msg.qos = qos;
+	msg.retained = 0;
 
 	if (MQTTAsync_isConnected(client) == 1)
 	{
 		int rc;
-		if ((rc = MQTTAsync_sendMessage(client, topic, &pubmsg, &pub_opts)) != MQTTASYNC_SUCCESS)
+		if ((rc = MQTTAsync_sendMessage(client, topic, &msg, &pub_opts)) != MQTTASYNC_SUCCESS)
 		{
 		printf("MQTT failed to start sendMessage, return code %d\n", rc);
 		LOG(WARNING) << "MQTT failed to start sendMessage, return code " << rc;
 		}
 	}
+}
+
+void myPublish(char *value, const char* topic, unsigned int qos)
+{
+	myPublishBytes(value, strlen(value), topic, qos);
 	delete[] value;
 }
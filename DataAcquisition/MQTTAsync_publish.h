@@ -25,6 +25,10 @@ int messageArrived(void *context, char *topicName, int topicLen, MQTTAsync_messa
 
 void MQTTConn(const char *address, const char *clientid);
 
+// Publishes `len` bytes of `payload`, which stays the caller's
+void myPublishBytes(const char *payload, int len, const char *topic, unsigned int qos);
+
+// Publishes the string `value` and delete[]s it
 void myPublish(char *value, const char *topic, unsigned int qos);
 
 #ifdef __cplusplus
@@ -0,0 +1,58 @@
+#include <stddef.h>
+#include <stdlib.h>
+#include <new>
+#include "alloc_counter.h"
+
+// Plain __thread data lives in static TLS, so bumping it never allocates
+static __thread uint64_t allocations;
+
+uint64_t threadAllocations()
+{
+    return allocations;
+}
+
+#ifdef __GLIBC__
+
+// glibc exports its allocator under these names, so the program can wrap
+// malloc and count every call, including the ones libraries make
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *__libc_calloc(size_t n, size_t size);
+extern "C" void *__libc_realloc(void *p, size_t size);
+
+extern "C" void *malloc(size_t size)
+{
+    ++allocations;
+    return __libc_malloc(size);
+}
+
+extern "C" void *calloc(size_t n, size_t size)
+{
+    ++allocations;
+    return __libc_calloc(n, size);
+}
+
+extern "C" void *realloc(void *p, size_t size)
+{
+    ++allocations;
+    return __libc_realloc(p, size);
+}
+
+#else
+
+void *operator new(size_t size)
+{
+    ++allocations;
+    void *p = malloc(size ? size : 1);
+    if (p == NULL)
+    {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void *p) noexcept
+{
+    free(p);
+}
+
+#endif
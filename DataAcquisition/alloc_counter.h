@@ -0,0 +1,11 @@
+#ifndef ALLOC_COUNTER_H
+#define ALLOC_COUNTER_H
+
+#include <stdint.h>
+
+// Heap allocations (malloc, calloc, realloc and everything built on them,
+// operator new included) made so far by the calling thread. Take the
+// difference around a code path to check it allocates nothing.
+uint64_t threadAllocations();
+
+#endif // ALLOC_COUNTER_H
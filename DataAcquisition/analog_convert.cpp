@@ -0,0 +1,245 @@
+#include <string.h>
+#include <type_traits>
+#include "analog_convert.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+static inline uint16_t bswap16(uint16_t v)
+{
+    return (uint16_t)((v >> 8) | (v << 8));
+}
+
+template <bool WordSwap, bool ByteSwap>
+static inline uint32_t loadPair(const uint16_t *p)
+{
+    uint16_t hi = WordSwap ? p[1] : p[0];
+    uint16_t lo = WordSwap ? p[0] : p[1];
+    if (ByteSwap)
+    {
+        hi = bswap16(hi);
+        lo = bswap16(lo);
+    }
+    return ((uint32_t)hi << 16) | lo;
+}
+
+template <typename T>
+static inline float fromRaw(uint32_t raw)
+{
+    return (float)(T)raw;
+}
+
+template <>
+inline float fromRaw<float>(uint32_t raw)
+{
+    float f;
+    memcpy(&f, &raw, sizeof(f));
+    return f;
+}
+
+template <bool Signed, bool ByteSwap>
+static void convert16Scalar(const uint16_t *c, int addr, int stride, int count, const float *scale, float *out)
+{
+    const uint16_t *p = c + addr;
+    if (scale)
+    {
+        for (int k = 0; k < count; ++k)
+        {
+            uint16_t w = ByteSwap ? bswap16(p[k * stride]) : p[k * stride];
+            out[k] = (Signed ? (float)(int16_t)w : (float)w) * scale[k];
+        }
+    }
+    else
+    {
+        for (int k = 0; k < count; ++k)
+        {
+            uint16_t w = ByteSwap ? bswap16(p[k * stride]) : p[k * stride];
+            out[k] = Signed ? (float)(int16_t)w : (float)w;
+        }
+    }
+}
+
+template <typename T, bool WordSwap, bool ByteSwap>
+static void convert32Scalar(const uint16_t *c, int addr, int stride, int count, const float *scale, float *out)
+{
+    const uint16_t *p = c + addr;
+    if (scale)
+    {
+        for (int k = 0; k < count; ++k)
+        {
+            out[k] = fromRaw<T>(loadPair<WordSwap, ByteSwap>(p + k * stride)) * scale[k];
+        }
+    }
+    else
+    {
+        for (int k = 0; k < count; ++k)
+        {
+            out[k] = fromRaw<T>(loadPair<WordSwap, ByteSwap>(p + k * stride));
+        }
+    }
+}
+
+#define ORDER_TABLE_16(kernel, ...) {kernel<__VA_ARGS__, false>, kernel<__VA_ARGS__, true>}
+#define ORDER_TABLE_32(kernel, ...) \
+    {{kernel<__VA_ARGS__, false, false>, kernel<__VA_ARGS__, false, true>}, \
+     {kernel<__VA_ARGS__, true, false>, kernel<__VA_ARGS__, true, true>}}
+
+const AnalogKernels analogKernelsScalar = {
+    "scalar",
+    ORDER_TABLE_16(convert16Scalar, false),
+    ORDER_TABLE_16(convert16Scalar, true),
+    ORDER_TABLE_32(convert32Scalar, uint32_t),
+    ORDER_TABLE_32(convert32Scalar, int32_t),
+    ORDER_TABLE_32(convert32Scalar, float)
+};
+
+#if defined(__x86_64__) || defined(__i386__)
+
+// Little-endian register pairs sit in memory as [w0 lo, w0 hi, w1 lo, w1 hi];
+// this puts the four bytes of every 32-bit lane in value order
+template <bool WordSwap, bool ByteSwap>
+__attribute__((target("avx2")))
+static inline __m256i pairControl()
+{
+    if (!WordSwap && !ByteSwap) // ABCD
+    {
+        return _mm256_setr_epi8(2, 3, 0, 1, 6, 7, 4, 5, 10, 11, 8, 9, 14, 15, 12, 13,
+                                2, 3, 0, 1, 6, 7, 4, 5, 10, 11, 8, 9, 14, 15, 12, 13);
+    }
+    if (WordSwap && !ByteSwap) // CDAB
+    {
+        return _mm256_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15,
+                                0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    }
+    if (!WordSwap && ByteSwap) // BADC
+    {
+        return _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+                                3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+    }
+    return _mm256_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14, // DCBA
+                            1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+}
+
+// Lanes at or past `n` are off. Every kernel finishes its run with one masked
+// block instead of a scalar tail, which would pay SSE/AVX transitions per run.
+__attribute__((target("avx2")))
+static inline __m256i laneMask(int n)
+{
+    return _mm256_cmpgt_epi32(_mm256_set1_epi32(n), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+}
+
+__attribute__((target("avx2")))
+static inline __m256i laneSteps(int stride)
+{
+    return _mm256_setr_epi32(0, stride, 2 * stride, 3 * stride, 4 * stride, 5 * stride, 6 * stride, 7 * stride);
+}
+
+// Eight 32-bit lanes from p[k * stride]: plain or masked loads when the word
+// pairs are back to back, a gather otherwise
+__attribute__((target("avx2")))
+static inline __m256i loadLanes32(const uint16_t *p, int stride, int k, __m256i mask, bool full)
+{
+    if (stride == 2)
+    {
+        return full ? _mm256_loadu_si256((const __m256i *)(p + k * 2))
+                    : _mm256_maskload_epi32((const int *)(p + k * 2), mask);
+    }
+    return _mm256_mask_i32gather_epi32(_mm256_setzero_si256(), (const int *)(p + k * stride), laneSteps(stride), mask, 2);
+}
+
+__attribute__((target("avx2")))
+static inline void storeLanes(float *out, const float *scale, int k, __m256 f, __m256i mask, bool full)
+{
+    if (full)
+    {
+        f = scale ? _mm256_mul_ps(f, _mm256_loadu_ps(scale + k)) : f;
+        _mm256_storeu_ps(out + k, f);
+    }
+    else
+    {
+        f = scale ? _mm256_mul_ps(f, _mm256_maskload_ps(scale + k, mask)) : f;
+        _mm256_maskstore_ps(out + k, mask, f);
+    }
+}
+
+template <bool Signed, bool ByteSwap>
+__attribute__((target("avx2")))
+static void convert16Avx2(const uint16_t *c, int addr, int stride, int count, const float *scale, float *out)
+{
+    const uint16_t *p = c + addr;
+    for (int k = 0; k < count; k += 8)
+    {
+        bool full = count - k >= 8;
+        __m256i mask = full ? _mm256_set1_epi32(-1) : laneMask(count - k);
+        __m256i v;
+        if (stride == 1 && full)
+        {
+            __m128i w = _mm_loadu_si128((const __m128i *)(p + k));
+            if (ByteSwap)
+            {
+                w = _mm_shuffle_epi8(w, _mm_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14));
+            }
+            v = Signed ? _mm256_cvtepi16_epi32(w) : _mm256_cvtepu16_epi32(w);
+        }
+        else
+        {
+            // Each gathered lane also holds the following register in its top half
+            v = _mm256_mask_i32gather_epi32(_mm256_setzero_si256(), (const int *)(p + k * stride), laneSteps(stride), mask, 2);
+            if (ByteSwap)
+            {
+                v = _mm256_shuffle_epi8(v, _mm256_setr_epi8(1, 0, -1, -1, 5, 4, -1, -1, 9, 8, -1, -1, 13, 12, -1, -1,
+                                                            1, 0, -1, -1, 5, 4, -1, -1, 9, 8, -1, -1, 13, 12, -1, -1));
+            }
+            v = Signed ? _mm256_srai_epi32(_mm256_slli_epi32(v, 16), 16) : _mm256_and_si256(v, _mm256_set1_epi32(0xFFFF));
+        }
+        storeLanes(out, scale, k, _mm256_cvtepi32_ps(v), mask, full);
+    }
+}
+
+template <typename T, bool WordSwap, bool ByteSwap>
+__attribute__((target("avx2")))
+static void convert32Avx2(const uint16_t *c, int addr, int stride, int count, const float *scale, float *out)
+{
+    const uint16_t *p = c + addr;
+    const __m256i ctrl = pairControl<WordSwap, ByteSwap>();
+    for (int k = 0; k < count; k += 8)
+    {
+        bool full = count - k >= 8;
+        __m256i mask = full ? _mm256_set1_epi32(-1) : laneMask(count - k);
+        __m256i v = _mm256_shuffle_epi8(loadLanes32(p, stride, k, mask, full), ctrl);
+        __m256 f = std::is_floating_point<T>::value ? _mm256_castsi256_ps(v) : _mm256_cvtepi32_ps(v);
+        storeLanes(out, scale, k, f, mask, full);
+    }
+}
+
+// AVX2 has no unsigned 32-bit to float conversion; UINT32 stays scalar
+const AnalogKernels analogKernelsAvx2 = {
+    "avx2",
+    ORDER_TABLE_16(convert16Avx2, false),
+    ORDER_TABLE_16(convert16Avx2, true),
+    ORDER_TABLE_32(convert32Scalar, uint32_t),
+    ORDER_TABLE_32(convert32Avx2, int32_t),
+    ORDER_TABLE_32(convert32Avx2, float)
+};
+
+static const AnalogKernels &selectAnalogKernels()
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") ? analogKernelsAvx2 : analogKernelsScalar;
+}
+
+#else
+
+static const AnalogKernels &selectAnalogKernels()
+{
+    return analogKernelsScalar;
+}
+
+#endif
+
+const AnalogKernels &analogKernels()
+{
+    static const AnalogKernels &kernels = selectAnalogKernels();
+    return kernels;
+}
@@ -0,0 +1,37 @@
+#ifndef ANALOG_CONVERT_H
+#define ANALOG_CONVERT_H
+
+#include <stdint.h>
+
+// Frames handed to the kernels carry this many spare words after the last
+// decoded register, so a 32-bit gather of a 16-bit register never leaves them
+#define REGISTER_PAD_WORDS 1
+
+// Batch conversion of one register run into `count` consecutive floats:
+// value k is read at c[addr + k * stride] and multiplied by scale[k] unless
+// `scale` is NULL. 32-bit kernels read the word pair at that address.
+typedef void (*ConvertFn)(const uint16_t *c, int addr, int stride, int count, const float *scale, float *out);
+
+// Every kernel is specialised on byte order so the inner loops carry no
+// order branches: index 16-bit tables by [byteSwap] and 32-bit tables by
+// [wordSwap][byteSwap] (wordSwap: low word first, byteSwap: BA inside words)
+struct AnalogKernels
+{
+    const char *isa;
+    ConvertFn u16[2];
+    ConvertFn i16[2];
+    ConvertFn u32[2][2];
+    ConvertFn i32[2][2];
+    ConvertFn f32[2][2];
+};
+
+// Picks the widest kernel set the CPU supports, once, on first use
+const AnalogKernels &analogKernels();
+
+extern const AnalogKernels analogKernelsScalar;
+
+#if defined(__x86_64__) || defined(__i386__)
+extern const AnalogKernels analogKernelsAvx2;
+#endif
+
+#endif // ANALOG_CONVERT_H
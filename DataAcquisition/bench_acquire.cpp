@@ -0,0 +1,154 @@
+// End-to-end acquisition benchmark: polls the devices of a config.json with
+// the Modbus engine, decodes every frame the way the writer does and reports
+// cycle latency percentiles. Point the devices at modbus_sim to try polling
+// rates, windows, poll groups and device counts without a PLC or TDengine.
+//
+//   ./bench_acquire [config.json] [seconds]
+//
+// Only the acquisition keys of the config are used (devices, poll_period_ms,
+// modbus_threads, response_timeout_ms, overrun_policy, reconnect_*_ms). A
+// cycle's latency runs from its first request to its last reply; decode is
+// timed on its own, as the writer thread adds it after the hand-off.
+#include <algorithm>
+#include <fstream>
+#include "gVal.h"
+#include "modbus_read.h"
+#include "modbus_engine.h"
+#include "device.h"
+
+INITIALIZE_EASYLOGGINGPP
+
+#define BENCH_DEFAULT_SECONDS 30
+
+// Samples of one device, written on the engine thread that polls it
+struct DeviceStats
+{
+    std::vector<int64_t> cycleNs;
+    std::vector<int64_t> decodeNs;
+    uint64_t frames = 0;
+    uint64_t missed = 0;
+    int lastError = 0;
+    std::vector<float> analogs;
+    std::vector<uint16_t> raws;
+    std::vector<uint8_t> bools;
+    std::vector<uint16_t> bits;
+};
+
+// Nearest-rank percentile of sorted samples, in ms
+static double percentileMs(const std::vector<int64_t> &sorted, double p)
+{
+    if (sorted.empty())
+    {
+        return 0;
+    }
+    size_t rank = (size_t)(p / 100 * sorted.size());
+    return sorted[std::min(rank, sorted.size() - 1)] / 1e6;
+}
+
+static void printLatency(const char *what, std::vector<int64_t> &samples)
+{
+    std::sort(samples.begin(), samples.end());
+    printf("  %-7s p50 %8.3f  p90 %8.3f  p99 %8.3f  p99.9 %8.3f  max %8.3f ms\n", what, percentileMs(samples, 50),
+           percentileMs(samples, 90), percentileMs(samples, 99), percentileMs(samples, 99.9),
+           samples.empty() ? 0 : samples.back() / 1e6);
+}
+
+int main(int argc, char *argv[])
+{
+    const char *path = argc > 1 ? argv[1] : "config.json";
+    int seconds = argc > 2 ? std::max(1, atoi(argv[2])) : BENCH_DEFAULT_SECONDS;
+    std::ifstream config_file(path);
+    if (!config_file.is_open())
+    {
+        printf("Failed to open %s\n", path);
+        return EXIT_FAILURE;
+    }
+    json config_data;
+    config_file >> config_data;
+    int modbus_threads = config_data.value("modbus_threads", DEFAULT_ENGINE_THREADS);
+    int poll_period_ms = std::max(1, config_data.value("poll_period_ms", DEFAULT_POLL_PERIOD_MS));
+    std::vector<Device> devices = loadDevices(config_data, 1, 1, 1, poll_period_ms);
+    printDevices(devices);
+
+    ModbusEngine engine;
+    engine.periodMs = poll_period_ms;
+    engine.responseTimeoutMs = config_data.value("response_timeout_ms", std::min(DEFAULT_RESPONSE_TIMEOUT_MS, poll_period_ms));
+    engine.overrun = config_data.value("overrun_policy", std::string("skip")) == "catch_up" ? OVERRUN_CATCH_UP : OVERRUN_SKIP;
+    engine.reconnectMinMs = std::max(1, config_data.value("reconnect_min_ms", DEFAULT_RECONNECT_MIN_MS));
+    engine.reconnectMaxMs = std::max(engine.reconnectMinMs, config_data.value("reconnect_max_ms", DEFAULT_RECONNECT_MAX_MS));
+
+    // Sized up front, so recording a sample never allocates on the engine
+    // threads; catch-up slots beyond it are not recorded
+    size_t expected = (size_t)seconds * 1000 / poll_period_ms + 16;
+    std::vector<DeviceStats> stats(devices.size());
+    for (size_t i = 0; i < devices.size(); ++i)
+    {
+        const Device &d = devices[i];
+        DeviceStats &st = stats[i];
+        st.cycleNs.reserve(expected);
+        st.decodeNs.reserve(expected);
+        st.analogs.resize(d.decode.analogCols);
+        st.raws.resize(d.rawPlan.analogCols);
+        st.bools.resize(d.plan.boolCols);
+        st.bits.resize(d.plan.boolCols / 16 + 1);
+    }
+
+    engine.onFrame = [&](const ModbusSession &s, const uint16_t *frame, int64_t) {
+        int64_t done = monotonicNs();
+        const Device &d = devices[s.id];
+        DeviceStats &st = stats[s.id];
+        decodeAnalog(d.decode, frame, st.analogs.data());
+        decodeRaw(d.rawPlan, frame, st.raws.data());
+        if (d.boolStorage == BOOL_PACKED)
+        {
+            packBool(d.plan, frame, st.bits.data());
+        }
+        else
+        {
+            decodeBool(d.plan, frame, st.bools.data());
+        }
+        ++st.frames;
+        if (st.cycleNs.size() < st.cycleNs.capacity())
+        {
+            st.cycleNs.push_back(done - s.cycleStartNs);
+            st.decodeNs.push_back(monotonicNs() - done);
+        }
+    };
+    engine.onMissed = [&](const ModbusSession &s, int64_t, int err) {
+        ++stats[s.id].missed;
+        stats[s.id].lastError = err;
+    };
+    for (const Device &d : devices)
+    {
+        engineAddSession(engine, {d.ip, d.port, d.standbyIp, d.standbyPort, d.slave, d.reads, d.groupEvery,
+                                  d.plan.frameWords, d.window});
+    }
+
+    engineStart(engine, modbus_threads);
+    sleepUntil(monotonicNs() + (int64_t)seconds * 1000000000);
+    engineStop(engine);
+
+    std::vector<int64_t> allCycles;
+    std::vector<int64_t> allDecodes;
+    uint64_t frames = 0;
+    uint64_t missed = 0;
+    for (size_t i = 0; i < devices.size(); ++i)
+    {
+        DeviceStats &st = stats[i];
+        printf("Device %d: %lu frames (%.1f/s), %lu missed%s%s\n", devices[i].id, (unsigned long)st.frames,
+               (double)st.frames / seconds, (unsigned long)st.missed, st.missed > 0 ? ", last: " : "",
+               st.missed > 0 ? modbus_strerror(st.lastError) : "");
+        printLatency("cycle", st.cycleNs);
+        printLatency("decode", st.decodeNs);
+        allCycles.insert(allCycles.end(), st.cycleNs.begin(), st.cycleNs.end());
+        allDecodes.insert(allDecodes.end(), st.decodeNs.begin(), st.decodeNs.end());
+        frames += st.frames;
+        missed += st.missed;
+    }
+    printf("All %zu devices: %lu frames (%.1f/s), %lu missed\n", devices.size(), (unsigned long)frames,
+           (double)frames / seconds, (unsigned long)missed);
+    printLatency("cycle", allCycles);
+    printLatency("decode", allDecodes);
+    engineReport(engine);
+    return 0;
+}
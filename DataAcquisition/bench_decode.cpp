@@ -0,0 +1,267 @@
+// Decode microbenchmark: the hardcoded extractAnalog/extractBool this tree
+// used to ship against the decode plan with each analog and bit-unpack kernel.
+//
+//   ./bench_decode [register_map.json] [frames.bin|-] [iterations]
+//
+// frames.bin holds raw register images back to back (plan.maxAddr + 1 words
+// each, host order); without it, or with -, random frames are generated.
+// Analog outputs are compared bit for bit, so NaN payloads in random frames
+// are checked too.
+#include <chrono>
+#include <fstream>
+#include <random>
+#include <string.h>
+#include "modbus.h"
+#include "register_map.h"
+#include "bit_unpack.h"
+#include "analog_convert.h"
+#include "easylogging++.h"
+
+INITIALIZE_EASYLOGGINGPP
+
+// extractAnalog as it was before the register map, kept as the reference
+static void legacyExtractAnalog(const uint16_t *c, float *new_array)
+{
+    static const int floatSpans[][2] = {
+        {355, 373}, {1050, 1104}, {1110, 1184}, {1250, 1344}, {1350, 1356},
+        {1362, 1364}, {1370, 1372}, {1378, 1380}, {1386, 1456}, {1470, 1510}
+    };
+    int index = 0;
+
+    for (int i = 1; i <= 107; i += 3)
+        new_array[index++] = c[i] * 0.01f;
+    for (int i = 108; i <= 119; i += 3)
+        new_array[index++] = c[i] * 0.1f;
+    new_array[index++] = c[120];
+    new_array[index++] = c[121] * 0.1f;
+    new_array[index++] = c[122] * 0.1f;
+    new_array[index++] = c[123] * 0.01f;
+    new_array[index++] = c[124] * 0.1f;
+    for (int i = 125; i <= 162; i++)
+        new_array[index++] = c[i] * 0.01f;
+    for (int i = 163; i <= 174; i++)
+        new_array[index++] = c[i];
+    new_array[index++] = c[175] * 0.1f;
+    new_array[index++] = c[176] * 0.01f;
+    for (int i = 300; i <= 304; i++)
+        new_array[index++] = c[i];
+    for (int i = 350; i <= 353; i++)
+        new_array[index++] = c[i];
+    for (const auto &span : floatSpans)
+    {
+        for (int i = span[0]; i <= span[1]; i += 2)
+            new_array[index++] = modbus_get_float_abcd(&c[i]);
+    }
+    for (int i = 3004; i <= 3020; i += 2)
+    {
+        int32_t dint = (c[i + 1] << 16) | c[i];
+        new_array[index++] = (float)dint;
+    }
+    new_array[index++] = c[3022];
+}
+
+// extractBool as it was before the register map, kept as the reference
+static void legacyExtractBool(const uint16_t *c, uint8_t *new_array)
+{
+    static const int spans[][2] = {
+        {500, 505}, {200, 204}, {250, 256}, {275, 276},
+        {1000, 1001}, {1005, 1008}, {1015, 1021}, {1025, 1026}
+    };
+    int index = 0;
+    uint16_t temp;
+
+    for (const auto &span : spans)
+    {
+        for (int i = span[0]; i <= span[1]; ++i)
+        {
+            temp = (c[i] >> 8) | (c[i] << 8);
+
+            for (int j = 0; j <= 15; ++j)
+            {
+                new_array[index++] = ((temp >> (15 - j)) & 1);
+            }
+        }
+    }
+}
+
+static void decodeBoolWith(const DecodePlan &plan, const uint16_t *c, uint8_t *out, UnpackBitsFn fn)
+{
+    for (const BoolSpan &s : plan.bools)
+    {
+        fn(c + s.addr, s.words, s.byteSwap, out + s.col);
+    }
+}
+
+// Frames are laid out `plan.frameWords` apart, padding zeroed
+static std::vector<uint16_t> loadFrames(const char *path, const DecodePlan &plan)
+{
+    int words = plan.maxAddr + 1;
+    std::vector<uint16_t> raw;
+    if (path != NULL)
+    {
+        std::ifstream file(path, std::ios::binary);
+        if (!file.is_open())
+        {
+            printf("Failed to open %s\n", path);
+            exit(EXIT_FAILURE);
+        }
+        std::vector<char> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        raw.resize(bytes.size() / sizeof(uint16_t) / words * words);
+        memcpy(raw.data(), bytes.data(), raw.size() * sizeof(uint16_t));
+    }
+    if (raw.empty())
+    {
+        std::mt19937 rng(20240101);
+        raw.resize((size_t)words * 64);
+        for (uint16_t &w : raw)
+        {
+            w = (uint16_t)rng();
+        }
+    }
+
+    size_t nFrames = raw.size() / words;
+    std::vector<uint16_t> frames(nFrames * plan.frameWords, 0);
+    for (size_t f = 0; f < nFrames; ++f)
+    {
+        memcpy(&frames[f * plan.frameWords], &raw[f * words], words * sizeof(uint16_t));
+    }
+    return frames;
+}
+
+template <typename F>
+static double nsPerFrame(int iterations, int nFrames, F &&body)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (int it = 0; it < iterations; ++it)
+    {
+        body(it % nFrames);
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count() / iterations;
+}
+
+int main(int argc, char *argv[])
+{
+    const char *mapPath = argc > 1 ? argv[1] : DEFAULT_REGISTER_MAP;
+    const char *framesPath = argc > 2 && strcmp(argv[2], "-") != 0 ? argv[2] : NULL;
+    int iterations = argc > 3 ? atoi(argv[3]) : 200000;
+
+    DecodePlan plan = compileDecodePlan(loadRegisterMap(mapPath));
+    int frameWords = plan.frameWords;
+    std::vector<uint16_t> frames = loadFrames(framesPath, plan);
+    int nFrames = (int)(frames.size() / frameWords);
+    bool legacyLayout = plan.analogCols == 307 && plan.boolCols == 560;
+
+    struct Kernel
+    {
+        const char *name;
+        UnpackBitsFn fn;
+    };
+    std::vector<Kernel> kernels = {{"scalar", unpackBitsScalar}};
+#if defined(__x86_64__) || defined(__i386__)
+    kernels.push_back({"sse2", unpackBitsSse2});
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+    {
+        kernels.push_back({"avx2", unpackBitsAvx2});
+    }
+#endif
+    std::vector<const AnalogKernels *> analogs = {&analogKernelsScalar};
+#if defined(__x86_64__) || defined(__i386__)
+    if (__builtin_cpu_supports("avx2"))
+    {
+        analogs.push_back(&analogKernelsAvx2);
+    }
+#endif
+
+    std::vector<float> expectA(plan.analogCols);
+    std::vector<float> gotA(plan.analogCols);
+    for (int f = 0; f < nFrames; ++f)
+    {
+        const uint16_t *c = &frames[(size_t)f * frameWords];
+        decodeAnalogWith(plan, c, expectA.data(), analogKernelsScalar);
+        if (legacyLayout)
+        {
+            legacyExtractAnalog(c, gotA.data());
+            if (memcmp(gotA.data(), expectA.data(), gotA.size() * sizeof(float)) != 0)
+            {
+                printf("Frame %d: decode plan differs from legacy extractAnalog\n", f);
+                return EXIT_FAILURE;
+            }
+        }
+        for (const AnalogKernels *k : analogs)
+        {
+            decodeAnalogWith(plan, c, gotA.data(), *k);
+            if (memcmp(gotA.data(), expectA.data(), gotA.size() * sizeof(float)) != 0)
+            {
+                printf("Frame %d: %s analog kernels differ from scalar\n", f, k->isa);
+                return EXIT_FAILURE;
+            }
+        }
+    }
+
+    std::vector<uint8_t> expect(plan.boolCols);
+    std::vector<uint8_t> got(plan.boolCols);
+    for (int f = 0; f < nFrames; ++f)
+    {
+        const uint16_t *c = &frames[(size_t)f * frameWords];
+        decodeBoolWith(plan, c, expect.data(), unpackBitsScalar);
+        if (legacyLayout)
+        {
+            legacyExtractBool(c, got.data());
+            if (got != expect)
+            {
+                printf("Frame %d: decode plan differs from legacy extractBool\n", f);
+                return EXIT_FAILURE;
+            }
+        }
+        for (const Kernel &k : kernels)
+        {
+            decodeBoolWith(plan, c, got.data(), k.fn);
+            if (got != expect)
+            {
+                printf("Frame %d: %s kernel differs from scalar\n", f, k.name);
+                return EXIT_FAILURE;
+            }
+        }
+    }
+    printf("%d frames, %d analog and %d bool cols, outputs identical; dispatch picks %s/%s\n",
+           nFrames, plan.analogCols, plan.boolCols, analogKernels().isa, unpackBitsIsa());
+
+    volatile float sinkA = 0;
+    if (legacyLayout)
+    {
+        double ns = nsPerFrame(iterations, nFrames, [&](int f) {
+            legacyExtractAnalog(&frames[(size_t)f * frameWords], gotA.data());
+            sinkA = sinkA + gotA[f % plan.analogCols];
+        });
+        printf("  %-16s %8.1f ns/frame\n", "legacy analog", ns);
+    }
+    for (const AnalogKernels *k : analogs)
+    {
+        double ns = nsPerFrame(iterations, nFrames, [&](int f) {
+            decodeAnalogWith(plan, &frames[(size_t)f * frameWords], gotA.data(), *k);
+            sinkA = sinkA + gotA[f % plan.analogCols];
+        });
+        printf("  analog %-9s %8.1f ns/frame\n", k->isa, ns);
+    }
+
+    volatile uint8_t sink = 0;
+    if (legacyLayout)
+    {
+        double ns = nsPerFrame(iterations, nFrames, [&](int f) {
+            legacyExtractBool(&frames[(size_t)f * frameWords], got.data());
+            sink = sink + got[f % plan.boolCols];
+        });
+        printf("  %-16s %8.1f ns/frame\n", "legacy bool", ns);
+    }
+    for (const Kernel &k : kernels)
+    {
+        double ns = nsPerFrame(iterations, nFrames, [&](int f) {
+            decodeBoolWith(plan, &frames[(size_t)f * frameWords], got.data(), k.fn);
+            sink = sink + got[f % plan.boolCols];
+        });
+        printf("  bool %-11s %8.1f ns/frame\n", k.name, ns);
+    }
+    return 0;
+}
@@ -0,0 +1,213 @@
+// Insert engine benchmark: the same rows through the statement engine
+// (newInsert) and the schemaless one (linesInsert), as the register map's
+// wide supertables and split into narrow per-subsystem ones, with every
+// column set (a full row) and with only the few that changed (a filtered
+// row, the rest NULL). Prints frames per second and CPU per frame.
+//
+//   ./bench_insert [register_map.json] [frames] [rows_per_insert] [subsystem_cols] [host user password database port]
+//
+// Linked with taos_stub.cpp instead of -ltaos it times our side only:
+// binding, or formatting the lines. Against a server it inserts into
+// `database`, which must exist, dropping and recreating the bench_*
+// supertables first; CPU then includes the client library's threads, not
+// the server's.
+#include <time.h>
+#include <chrono>
+#include <random>
+#include "gVal.h"
+#include "device.h"
+#include "myTaos.h"
+#include "data_acquisition_save.h"
+
+#define BENCH_DEFAULT_FRAMES 12000
+#define BENCH_DEFAULT_SUBSYSTEM_COLS 16
+// Share of columns a filtered row still holds
+#define BENCH_CHANGE_FRACTION 0.05
+
+// One supertable's worth of rows
+struct BenchTable
+{
+    Device device; // only id, table and stable are used
+    const char *kind;
+    const char *type;
+    ColumnBatch<float> analogs;
+    ColumnBatch<uint8_t> bools;
+    SubtableName names;
+};
+
+static double cpuSeconds()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void benchSql(TAOS *conn, const std::string &sql)
+{
+    if (!resultOk(taos_query(conn, sql.c_str()), sql.c_str()))
+    {
+        exit(EXIT_FAILURE);
+    }
+}
+
+template <typename T>
+static void fillBatch(ColumnBatch<T> &b, int rows, bool filtered, std::mt19937 &rng)
+{
+    b.count = rows;
+    for (int c = 0; c < b.cols; ++c)
+    {
+        for (int r = 0; r < rows; ++r)
+        {
+            size_t at = (size_t)c * b.capacity + r;
+            b.data[at] = std::is_same<T, float>::value ? (T)(rng() % 100000 / 100.0) : (T)(rng() & 1);
+            b.nulls[at] = filtered && rng() % 1000 >= BENCH_CHANGE_FRACTION * 1000;
+        }
+    }
+    // A filtered row keeps at least one value, or it would not be stored
+    for (int r = 0; r < rows; ++r)
+    {
+        b.nulls[(size_t)(rng() % b.cols) * b.capacity + r] = 0;
+    }
+}
+
+// Tables of `kind` with `cols` columns in all: one, or one per
+// `subsystemCols` of them
+static void addTables(std::vector<std::unique_ptr<BenchTable>> &tables, const std::string &prefix, const char *kind,
+                      const char *type, int cols, int subsystemCols, int rows)
+{
+    // Writers cache statements by device, so every table is a device of its own
+    static int nextId = 1;
+    int width = subsystemCols > 0 ? subsystemCols : cols;
+    for (int first = 0, k = 0; first < cols; first += width, ++k)
+    {
+        tables.emplace_back(new BenchTable());
+        BenchTable &t = *tables.back();
+        t.device.id = nextId++;
+        t.device.stable = prefix + (subsystemCols > 0 ? "_" + std::to_string(k) : "");
+        t.device.table = "bench" + t.device.stable + "_";
+        t.kind = kind;
+        t.type = type;
+        int n = std::min(width, cols - first);
+        if (strcmp(type, "FLOAT") == 0)
+        {
+            t.analogs.init(n, rows);
+        }
+        else
+        {
+            t.bools.init(n, rows);
+        }
+    }
+}
+
+static bool insertTable(WriterShard &shard, BenchTable &t)
+{
+    if (t.analogs.cols > 0)
+    {
+        return insertBatch(shard, t.analogs, t.names, t.device, t.kind, std::string(t.type));
+    }
+    return insertBatch(shard, t.bools, t.names, t.device, t.kind, std::string(t.type));
+}
+
+static void runEngine(WriterShard &shard, const char *engine, const char *shape, const DecodePlan &plan, int frames,
+                      int rows, int subsystemCols, bool filtered)
+{
+    std::string prefix = std::string("_bench_") + engine + "_" + shape + (filtered ? "_filtered" : "_full");
+    std::vector<std::unique_ptr<BenchTable>> tables;
+    addTables(tables, prefix, "analog", "FLOAT", plan.analogCols, subsystemCols, rows);
+    addTables(tables, prefix, "bool", "BOOL", plan.boolCols, subsystemCols, rows);
+
+    // Supertables start afresh; the schemaless engine makes its own
+    for (auto &t : tables)
+    {
+        std::string stable = "s_" + std::string(t->kind) + t->device.stable;
+        int cols = t->analogs.cols > 0 ? t->analogs.cols : t->bools.cols;
+        benchSql(shard.conn, "DROP STABLE IF EXISTS " + stable);
+        if (shard.engine == INSERT_STMT)
+        {
+            std::string sql = "CREATE STABLE " + stable + " (ts TIMESTAMP";
+            for (int c = 0; c < cols; ++c)
+            {
+                sql += ", c" + std::to_string(c) + " " + t->type;
+            }
+            benchSql(shard.conn, sql + ") TAGS (dev INT)");
+        }
+    }
+
+    std::mt19937 rng(20240101);
+    for (auto &t : tables)
+    {
+        if (t->analogs.cols > 0)
+        {
+            fillBatch(t->analogs, rows, filtered, rng);
+        }
+        else
+        {
+            fillBatch(t->bools, rows, filtered, rng);
+        }
+    }
+
+    int64_t ts = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    double wall = 0;
+    double cpu = 0;
+    int inserted = 0;
+    while (inserted < frames)
+    {
+        for (int r = 0; r < rows; ++r)
+        {
+            ts += 100;
+            for (auto &t : tables)
+            {
+                (t->analogs.cols > 0 ? t->analogs.ts : t->bools.ts)[r] = ts;
+            }
+        }
+        auto start = std::chrono::steady_clock::now();
+        double cpuStart = cpuSeconds();
+        for (auto &t : tables)
+        {
+            if (!insertTable(shard, *t))
+            {
+                exit(EXIT_FAILURE);
+            }
+        }
+        cpu += cpuSeconds() - cpuStart;
+        wall += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        inserted += rows;
+    }
+    printf("  %-10s %-6s %3zu tables %-8s %12.0f frames/s %10.2f us CPU/frame\n", engine, shape, tables.size(),
+           filtered ? "filtered" : "full", inserted / wall, cpu * 1e6 / inserted);
+}
+
+int main(int argc, char *argv[])
+{
+    const char *mapPath = argc > 1 ? argv[1] : DEFAULT_REGISTER_MAP;
+    int frames = argc > 2 ? std::max(1, atoi(argv[2])) : BENCH_DEFAULT_FRAMES;
+    int rows = argc > 3 ? std::max(1, atoi(argv[3])) : DEFAULT_FLUSH_MAX_ROWS;
+    int subsystemCols = argc > 4 ? std::max(1, atoi(argv[4])) : BENCH_DEFAULT_SUBSYSTEM_COLS;
+    const char *host = argc > 5 ? argv[5] : "127.0.0.1";
+    const char *user = argc > 6 ? argv[6] : "root";
+    const char *password = argc > 7 ? argv[7] : "taosdata";
+    const char *database = argc > 8 ? argv[8] : "bench";
+    uint16_t port = argc > 9 ? (uint16_t)atoi(argv[9]) : 6030;
+
+    json config_data = {{"devices", {{{"ip", "127.0.0.1"}, {"port", 502}, {"slave", 1}, {"register_map", mapPath}}}}};
+    std::vector<Device> devices = loadDevices(config_data, 1, DEVICE_FRAME_SLOTS, rows, DEFAULT_POLL_PERIOD_MS);
+    const DecodePlan &plan = devices[0].plan;
+    printf("%d analog and %d bool cols, %d frames, %d rows per insert, %d cols per subsystem table\n", plan.analogCols,
+           plan.boolCols, frames, rows, subsystemCols);
+
+    WriterShard shard;
+    shard.id = 0;
+    shard.conn = taosConnect(host, user, password, database, port);
+    for (InsertEngine engine : {INSERT_STMT, INSERT_SCHEMALESS})
+    {
+        shard.engine = engine;
+        const char *name = engine == INSERT_STMT ? "stmt" : "schemaless";
+        for (bool filtered : {false, true})
+        {
+            runEngine(shard, name, "wide", plan, frames, rows, 0, filtered);
+            runEngine(shard, name, "narrow", plan, frames, rows, subsystemCols, filtered);
+        }
+    }
+    taos_close(shard.conn);
+    return 0;
+}
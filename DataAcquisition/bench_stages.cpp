@@ -0,0 +1,281 @@
+// Per-stage acquisition microbenchmarks: each stage of a frame's way from
+// the Modbus replies to TDengine, timed on its own over the same register
+// images, in ns and heap allocations per frame.
+//
+//   ./bench_stages [register_map.json] [frames.bin|-] [iterations] [float|raw] [columns|packed]
+//
+// reply    parse the MBAP replies of every read into the frame image
+// decode   decode the whole image into analog, raw and bool rows
+// filter   decode and commit through the change filters into row batches
+// handoff  queueFrame and drainFrames: ring copy, decode and filter of what changed
+// bind     insertRows of full batches against a stubbed TDengine (taos_stub.cpp), per row
+// latest   decode into the latest frame
+// keyframe latest, then format a live keyframe
+// live     latest, then format a live delta of what changed
+//
+// frames.bin is bench_decode's format (plan.maxAddr + 1 words per frame,
+// host order), consecutive scans of a plant are the most telling. Without it
+// frames are generated from a random image where a few registers change per
+// scan. Each stage runs once before it is timed, so one-off allocations
+// (statements, batches) are not counted.
+#include <chrono>
+#include <fstream>
+#include <random>
+#include <taskflow/taskflow.hpp>
+#include "gVal.h"
+#include "modbus_read.h"
+#include "modbus_engine.h"
+#include "device.h"
+#include "myTaos.h"
+#include "data_acquisition_save.h"
+#include "taos_stub.h"
+#include "latest_frame.h"
+#include "live_publish.h"
+
+#define BENCH_SYNTHETIC_FRAMES 256
+// Share of decoded registers a synthetic scan changes
+#define BENCH_CHANGE_FRACTION 0.05
+// Long enough that the live stage never comes to a keyframe
+#define BENCH_KEYFRAME_MS 3600000
+
+static std::vector<uint16_t> loadFrames(const char *path, const DecodePlan &plan)
+{
+    int words = plan.maxAddr + 1;
+    std::vector<uint16_t> raw;
+    if (path != NULL)
+    {
+        std::ifstream file(path, std::ios::binary);
+        if (!file.is_open())
+        {
+            printf("Failed to open %s\n", path);
+            exit(EXIT_FAILURE);
+        }
+        std::vector<char> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        raw.resize(bytes.size() / sizeof(uint16_t) / words * words);
+        memcpy(raw.data(), bytes.data(), raw.size() * sizeof(uint16_t));
+    }
+    if (raw.empty())
+    {
+        std::mt19937 rng(20240101);
+        std::vector<int> regs = decodedRegisters(plan);
+        raw.resize((size_t)words * BENCH_SYNTHETIC_FRAMES);
+        for (int a : regs)
+        {
+            raw[a] = (uint16_t)rng();
+        }
+        for (size_t f = 1; f < BENCH_SYNTHETIC_FRAMES; ++f)
+        {
+            memcpy(&raw[f * words], &raw[(f - 1) * words], words * sizeof(uint16_t));
+            for (size_t k = 0; k < regs.size() * BENCH_CHANGE_FRACTION; ++k)
+            {
+                raw[f * words + regs[rng() % regs.size()]] += (uint16_t)(rng() % 7 + 1);
+            }
+        }
+    }
+
+    size_t nFrames = raw.size() / words;
+    std::vector<uint16_t> frames(nFrames * plan.frameWords, 0);
+    for (size_t f = 0; f < nFrames; ++f)
+    {
+        memcpy(&frames[f * plan.frameWords], &raw[f * words], words * sizeof(uint16_t));
+    }
+    return frames;
+}
+
+// What each reply of a frame looks like on the wire
+static void encodeReply(std::vector<uint8_t> &out, const uint16_t *frame, int slave, const ReadRequest &r)
+{
+    out.resize(9 + 2 * r.nb);
+    out[0] = 0;
+    out[1] = 1;
+    out[2] = out[3] = 0;
+    out[4] = (uint8_t)((3 + 2 * r.nb) >> 8);
+    out[5] = (uint8_t)(3 + 2 * r.nb);
+    out[6] = (uint8_t)slave;
+    out[7] = 3;
+    out[8] = (uint8_t)(2 * r.nb);
+    for (int i = 0; i < r.nb; ++i)
+    {
+        out[9 + 2 * i] = (uint8_t)(frame[r.addr + i] >> 8);
+        out[10 + 2 * i] = (uint8_t)frame[r.addr + i];
+    }
+}
+
+// Times `body(frame)` over `iterations` frames after one warm-up call; each
+// call covers `perCall` frames (or rows)
+template <typename F>
+static void runStage(const char *name, int iterations, int nFrames, int perCall, F &&body)
+{
+    body(0);
+    uint64_t mark = threadAllocations();
+    auto start = std::chrono::steady_clock::now();
+    for (int it = 0; it < iterations; ++it)
+    {
+        body(it % nFrames);
+    }
+    auto end = std::chrono::steady_clock::now();
+    double frames = (double)iterations * perCall;
+    printf("  %-8s %10.1f ns/frame %8.2f allocs/frame\n", name,
+           std::chrono::duration<double, std::nano>(end - start).count() / frames,
+           (threadAllocations() - mark) / frames);
+}
+
+static void clearBatches(Device &d)
+{
+    d.analogs.clear();
+    d.raws.clear();
+    d.bools.clear();
+    d.bits.clear();
+    d.missed.clear();
+}
+
+static bool batchFull(const Device &d)
+{
+    return d.analogs.count == d.analogs.capacity || d.raws.count == d.raws.capacity || d.bools.count == d.bools.capacity ||
+           d.bits.count == d.bits.capacity;
+}
+
+int main(int argc, char *argv[])
+{
+    const char *mapPath = argc > 1 ? argv[1] : DEFAULT_REGISTER_MAP;
+    const char *framesPath = argc > 2 && strcmp(argv[2], "-") != 0 ? argv[2] : NULL;
+    int iterations = argc > 3 ? std::max(1, atoi(argv[3])) : 20000;
+    std::string analogStorage = argc > 4 ? argv[4] : "float";
+    std::string boolStorage = argc > 5 ? argv[5] : "columns";
+
+    json config_data = {{"devices", {{{"ip", "127.0.0.1"}, {"port", 502}, {"slave", 1}, {"register_map", mapPath}}}},
+                        {"analog_storage", analogStorage},
+                        {"bool_storage", boolStorage}};
+    std::vector<Device> devices = loadDevices(config_data, 1, DEVICE_FRAME_SLOTS, DEFAULT_FLUSH_MAX_ROWS, DEFAULT_POLL_PERIOD_MS);
+    Device &d = devices[0];
+    std::vector<uint16_t> frames = loadFrames(framesPath, d.plan);
+    int frameWords = d.plan.frameWords;
+    int nFrames = (int)(frames.size() / frameWords);
+    auto frameAt = [&](int f) { return &frames[(size_t)f * frameWords]; };
+
+    // Replies, and which reads each frame changes against the one before
+    std::vector<std::vector<std::vector<uint8_t>>> replies(nFrames, std::vector<std::vector<uint8_t>>(d.reads.size()));
+    std::vector<uint64_t> changed(nFrames);
+    std::vector<uint16_t> image(frameWords, 0);
+    for (int f = 0; f < nFrames; ++f)
+    {
+        for (size_t r = 0; r < d.reads.size(); ++r)
+        {
+            encodeReply(replies[f][r], frameAt(f), d.slave, d.reads[r]);
+            if (decodeReadReply(replies[f][r].data(), (int)replies[f][r].size(), d.slave, d.reads[r], image.data()) == 1)
+            {
+                changed[f] |= 1ull << std::min(r, (size_t)63);
+            }
+        }
+    }
+    changed[0] = d.allReads;
+    printf("%d frames, %zu reads, %d analog (%d raw) and %d bool cols, %s bools, %d rows per insert\n", nFrames,
+           d.reads.size(), d.plan.analogCols, d.rawPlan.analogCols, d.plan.boolCols, boolStorage.c_str(), d.analogs.capacity);
+
+    runStage("reply", iterations, nFrames, 1, [&](int f) {
+        for (size_t r = 0; r < d.reads.size(); ++r)
+        {
+            decodeReadReply(replies[f][r].data(), (int)replies[f][r].size(), d.slave, d.reads[r], image.data());
+        }
+    });
+
+    runStage("decode", iterations, nFrames, 1, [&](int f) {
+        decodeAnalog(d.decode, frameAt(f), d.analogs.stage());
+        decodeRaw(d.rawPlan, frameAt(f), d.raws.stage());
+        decodeBools(d, d.decode, frameAt(f));
+    });
+
+    int64_t t0 = 1760000000000;
+    int64_t ts = t0;
+    runStage("filter", iterations, nFrames, 1, [&](int f) {
+        if (batchFull(d))
+        {
+            clearBatches(d);
+        }
+        decodeAnalog(d.decode, frameAt(f), d.analogs.stage());
+        decodeRaw(d.rawPlan, frameAt(f), d.raws.stage());
+        decodeBools(d, d.decode, frameAt(f));
+        ts += 100;
+        commitChanged(d.analogs, d.analogFilter, ts, ~0ull);
+        commitChanged(d.raws, d.rawFilter, ts, ~0ull);
+        commitChanged(d.bools, d.boolFilter, ts, ~0ull);
+        commitChanged(d.bits, d.bitFilter, ts, ~0ull);
+    });
+
+    WriterShard shard;
+    shard.id = 0;
+    shard.conn = taosTryConnect("127.0.0.1", "root", "taosdata", "bench", 6030);
+    shard.retryMs = 0;
+    shard.retryAt = 0;
+    shard.lostBatches = 0;
+    shard.rows = d.analogs.capacity;
+    sem_init(&shard.ready, 0, 0);
+    clearBatches(d);
+    runStage("handoff", iterations, nFrames, 1, [&](int f) {
+        if (batchFull(d))
+        {
+            clearBatches(d);
+        }
+        ts += 100;
+        queueFrame(shard, d, frameAt(f), ts, changed[f], 1);
+        sem_trywait(&shard.ready);
+        drainFrames(shard, d);
+    });
+
+    // Full batches of consecutive frames, within one day
+    clearBatches(d);
+    ts = t0;
+    for (int f = 0; !batchFull(d); ++f)
+    {
+        decodeAnalog(d.decode, frameAt(f % nFrames), d.analogs.stage());
+        decodeRaw(d.rawPlan, frameAt(f % nFrames), d.raws.stage());
+        decodeBools(d, d.decode, frameAt(f % nFrames));
+        ts += 100;
+        d.analogs.commit(ts);
+        d.raws.commit(ts);
+        d.bools.commit(ts);
+        d.bits.commit(ts);
+    }
+    uint64_t bound = taosStubRowsBound();
+    runStage("bind", std::max(1, iterations / d.analogs.capacity), 1, d.analogs.capacity, [&](int) {
+        insertRows(shard, d, d.analogs, d.raws, d.bools, d.bits, d.missed, d.analogTable, d.rawTable, d.boolTable,
+                   d.bitTable, d.missedTable);
+    });
+    if (taosStubRowsBound() == bound)
+    {
+        printf("  bind inserted nothing\n");
+        return EXIT_FAILURE;
+    }
+
+    // Live publishing from the latest frame, kept in memory here rather than
+    // in shared memory
+    LatestFrame latest;
+    if (latestCreate(&latest, NULL, d.id, d.plan.analogCols, d.plan.boolCols) != 0)
+    {
+        printf("  latest frame: %s\n", strerror(errno));
+        return EXIT_FAILURE;
+    }
+    auto writeLatest = [&](int f) {
+        latestBeginWrite(&latest);
+        decodeAnalog(d.plan, frameAt(f), latest.analogs);
+        decodeBool(d.plan, frameAt(f), latest.bools);
+        latestEndWrite(&latest, ++ts);
+    };
+    LivePublisher live;
+    liveAdd(live, d.id, latest, d.plan.analogBands, "live/1");
+    LiveDevice &ld = live.devices[0];
+    writeLatest(0);
+    runStage("latest", iterations, nFrames, 1, writeLatest);
+    runStage("keyframe", std::max(1, iterations / 10), 1, 1, [&](int) {
+        writeLatest(0);
+        liveFormat(ld, 0, 0);
+    });
+    int sent = 0;
+    runStage("live", iterations, nFrames, 1, [&](int f) {
+        writeLatest(f);
+        sent += liveFormat(ld, 0, BENCH_KEYFRAME_MS) > 0;
+    });
+    printf("  live sent a delta for %.0f%% of frames\n", 100.0 * sent / (iterations + 1));
+    latestClose(&latest);
+    return 0;
+}
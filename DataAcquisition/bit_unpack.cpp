@@ -0,0 +1,165 @@
+#include <string.h>
+#include "bit_unpack.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+struct UnpackBitsImpl
+{
+    const char *isa;
+    UnpackBitsFn fn;
+};
+
+void unpackBitsScalar(const uint16_t *src, int words, bool byteSwap, uint8_t *dst)
+{
+    for (int i = 0; i < words; ++i)
+    {
+        uint16_t temp = byteSwap ? (uint16_t)((src[i] >> 8) | (src[i] << 8)) : src[i];
+        for (int j = 0; j <= 15; ++j)
+        {
+            *dst++ = (temp >> (15 - j)) & 1;
+        }
+    }
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+// Byte k of every 8-byte group tests bit 7 - k, so the bytes come out MSB first
+#define BIT_MASK_8 (char)0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01
+
+// Each byte of `v` already holds a copy of its source byte: keep the tested bit
+// and clamp it to 1
+static inline __m128i selectBits(__m128i v)
+{
+    const __m128i mask = _mm_setr_epi8(BIT_MASK_8, BIT_MASK_8);
+    return _mm_min_epu8(_mm_and_si128(v, mask), _mm_set1_epi8(1));
+}
+
+// The PLC words arrive as [lo, hi] in memory. The legacy BA order wants the
+// low byte's bits first, which is memory order, so only AB needs a swap here.
+static inline __m128i orderBytes(__m128i x, bool byteSwap)
+{
+    return byteSwap ? x : _mm_or_si128(_mm_slli_epi16(x, 8), _mm_srli_epi16(x, 8));
+}
+
+void unpackBitsSse2(const uint16_t *src, int words, bool byteSwap, uint8_t *dst)
+{
+    int i = 0;
+    for (; i + 4 <= words; i += 4, dst += 64)
+    {
+        __m128i x = orderBytes(_mm_loadl_epi64((const __m128i *)(src + i)), byteSwap);
+        __m128i y = _mm_unpacklo_epi8(x, x);
+        __m128i lo = _mm_unpacklo_epi16(y, y);
+        __m128i hi = _mm_unpackhi_epi16(y, y);
+        _mm_storeu_si128((__m128i *)(dst + 0), selectBits(_mm_unpacklo_epi32(lo, lo)));
+        _mm_storeu_si128((__m128i *)(dst + 16), selectBits(_mm_unpackhi_epi32(lo, lo)));
+        _mm_storeu_si128((__m128i *)(dst + 32), selectBits(_mm_unpacklo_epi32(hi, hi)));
+        _mm_storeu_si128((__m128i *)(dst + 48), selectBits(_mm_unpackhi_epi32(hi, hi)));
+    }
+
+    for (; i < words; ++i, dst += 16)
+    {
+        __m128i x = orderBytes(_mm_cvtsi32_si128(src[i]), byteSwap);
+        __m128i y = _mm_unpacklo_epi8(x, x);
+        y = _mm_unpacklo_epi16(y, y);
+        _mm_storeu_si128((__m128i *)dst, selectBits(_mm_unpacklo_epi32(y, y)));
+    }
+}
+
+// pshufb stays inside each 128-bit lane, so the source bytes are broadcast to
+// both lanes and every lane picks the two bytes of its own word
+__attribute__((target("avx2")))
+void unpackBitsAvx2(const uint16_t *src, int words, bool byteSwap, uint8_t *dst)
+{
+    const __m256i mask = _mm256_setr_epi8(BIT_MASK_8, BIT_MASK_8, BIT_MASK_8, BIT_MASK_8);
+    const __m256i one = _mm256_set1_epi8(1);
+    // Words 0, 1 and words 2, 3 of a 64-bit load; BA takes memory byte 0 first
+    const __m256i ctrlBA0 = _mm256_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1,
+                                             2, 2, 2, 2, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3);
+    const __m256i ctrlBA1 = _mm256_setr_epi8(4, 4, 4, 4, 4, 4, 4, 4, 5, 5, 5, 5, 5, 5, 5, 5,
+                                             6, 6, 6, 6, 6, 6, 6, 6, 7, 7, 7, 7, 7, 7, 7, 7);
+    const __m256i ctrlAB0 = _mm256_setr_epi8(1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0,
+                                             3, 3, 3, 3, 3, 3, 3, 3, 2, 2, 2, 2, 2, 2, 2, 2);
+    const __m256i ctrlAB1 = _mm256_setr_epi8(5, 5, 5, 5, 5, 5, 5, 5, 4, 4, 4, 4, 4, 4, 4, 4,
+                                             7, 7, 7, 7, 7, 7, 7, 7, 6, 6, 6, 6, 6, 6, 6, 6);
+    const __m256i ctrl0 = byteSwap ? ctrlBA0 : ctrlAB0;
+    const __m256i ctrl1 = byteSwap ? ctrlBA1 : ctrlAB1;
+
+    int i = 0;
+    for (; i + 4 <= words; i += 4, dst += 64)
+    {
+        int64_t raw;
+        memcpy(&raw, src + i, sizeof(raw));
+        __m256i x = _mm256_set1_epi64x(raw);
+        __m256i a = _mm256_shuffle_epi8(x, ctrl0);
+        __m256i b = _mm256_shuffle_epi8(x, ctrl1);
+        _mm256_storeu_si256((__m256i *)dst, _mm256_min_epu8(_mm256_and_si256(a, mask), one));
+        _mm256_storeu_si256((__m256i *)(dst + 32), _mm256_min_epu8(_mm256_and_si256(b, mask), one));
+    }
+
+    if (i + 2 <= words)
+    {
+        int32_t raw;
+        memcpy(&raw, src + i, sizeof(raw));
+        __m256i a = _mm256_shuffle_epi8(_mm256_set1_epi32(raw), ctrl0);
+        _mm256_storeu_si256((__m256i *)dst, _mm256_min_epu8(_mm256_and_si256(a, mask), one));
+        i += 2;
+        dst += 32;
+    }
+
+    if (i < words)
+    {
+        __m256i a = _mm256_shuffle_epi8(_mm256_set1_epi32(src[i]), ctrl0);
+        __m128i lo = _mm256_castsi256_si128(_mm256_min_epu8(_mm256_and_si256(a, mask), one));
+        _mm_storeu_si128((__m128i *)dst, lo);
+    }
+}
+
+static UnpackBitsImpl selectUnpackBits()
+{
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+    {
+        return {"avx2", unpackBitsAvx2};
+    }
+    return {"sse2", unpackBitsSse2};
+}
+
+#else
+
+static UnpackBitsImpl selectUnpackBits()
+{
+    return {"scalar", unpackBitsScalar};
+}
+
+#endif
+
+static const UnpackBitsImpl &unpackBitsImpl()
+{
+    static const UnpackBitsImpl impl = selectUnpackBits();
+    return impl;
+}
+
+void unpackBits(const uint16_t *src, int words, bool byteSwap, uint8_t *dst)
+{
+    unpackBitsImpl().fn(src, words, byteSwap, dst);
+}
+
+const char *unpackBitsIsa()
+{
+    return unpackBitsImpl().isa;
+}
+
+void packBits(const uint16_t *src, int words, bool byteSwap, uint16_t *dst)
+{
+    if (!byteSwap)
+    {
+        memcpy(dst, src, words * sizeof(uint16_t));
+        return;
+    }
+    for (int i = 0; i < words; ++i)
+    {
+        dst[i] = (uint16_t)((src[i] >> 8) | (src[i] << 8));
+    }
+}
@@ -0,0 +1,28 @@
+#ifndef BIT_UNPACK_H
+#define BIT_UNPACK_H
+
+#include <stdint.h>
+
+// Spreads `words` registers into 16 bytes each (0 or 1), most significant bit
+// first. With `byteSwap` each word is byte-swapped before unpacking, which is
+// what extractBool has always done for the BA-ordered PLC status words.
+typedef void (*UnpackBitsFn)(const uint16_t *src, int words, bool byteSwap, uint8_t *dst);
+
+// Picks the widest kernel the CPU supports, once, on first use
+void unpackBits(const uint16_t *src, int words, bool byteSwap, uint8_t *dst);
+
+const char *unpackBitsIsa();
+
+// The same bits kept packed: each word stored as is, or byte-swapped, so bit
+// 15 - j of dst[i] is what unpackBits writes to byte 16 * i + j
+void packBits(const uint16_t *src, int words, bool byteSwap, uint16_t *dst);
+
+void unpackBitsScalar(const uint16_t *src, int words, bool byteSwap, uint8_t *dst);
+
+#if defined(__x86_64__) || defined(__i386__)
+void unpackBitsSse2(const uint16_t *src, int words, bool byteSwap, uint8_t *dst);
+
+void unpackBitsAvx2(const uint16_t *src, int words, bool byteSwap, uint8_t *dst);
+#endif
+
+#endif // BIT_UNPACK_H
@@ -0,0 +1,120 @@
+#ifndef CHANGE_FILTER_H
+#define CHANGE_FILTER_H
+
+#include <math.h>
+#include <algorithm>
+#include <vector>
+#include "register_map.h"
+#include "frame_ring.h"
+
+// Last stored value and time of every column of one batch. Columns without
+// a band are stored every sample their poll group is read in.
+template <typename T>
+struct ChangeFilter
+{
+    std::vector<Deadband> bands;
+    std::vector<T> last;
+    std::vector<int64_t> lastMs; // -1 until the first stored value
+    int64_t rowMs = -1;          // last stored row
+    bool any = false;
+    uint64_t groups = 0;         // poll groups of the columns
+
+    void init(const std::vector<Deadband> &columnBands)
+    {
+        bands = columnBands;
+        last.assign(bands.size(), T());
+        lastMs.assign(bands.size(), -1);
+        any = std::any_of(bands.begin(), bands.end(), [](const Deadband &b) { return b.enabled; });
+        groups = 0;
+        for (const Deadband &b : bands)
+        {
+            groups |= 1ull << b.group;
+        }
+    }
+};
+
+static inline bool changed(float v, float last, const Deadband &b)
+{
+    if (isnan(v) || isnan(last))
+    {
+        return isnan(v) != isnan(last);
+    }
+    return fabsf(v - last) > std::max(b.abs, b.pct * 0.01f * fabsf(last));
+}
+
+static inline bool changed(uint8_t v, uint8_t last, const Deadband &)
+{
+    return v != last;
+}
+
+// Packed bools, stored when any bit flips, and raw 16-bit registers, whose
+// bands are in register units
+static inline bool changed(uint16_t v, uint16_t last, const Deadband &b)
+{
+    if (b.abs == 0 && b.pct == 0)
+    {
+        return v != last;
+    }
+    float x = b.rawSigned ? (int16_t)v : v;
+    float y = b.rawSigned ? (int16_t)last : last;
+    return fabsf(x - y) > std::max(b.abs, b.pct * 0.01f * fabsf(y));
+}
+
+// Commits the staged row with every filtered column that has neither moved
+// out of its band nor reached its heartbeat set NULL, so the stored series
+// reads back by carrying the last value forward. Columns of poll groups not
+// in `polled` were not read for this frame and are NULL too, so every value
+// keeps the time it was read at. A row left with no values is not stored at
+// all. The batch must have room for a row.
+template <typename T>
+void commitChanged(ColumnBatch<T> &batch, ChangeFilter<T> &f, int64_t millis, uint64_t polled)
+{
+    if (!f.any && (polled & f.groups) == f.groups)
+    {
+        if (batch.cols > 0 && batch.commit(millis))
+        {
+            f.rowMs = millis;
+        }
+        return;
+    }
+    const T *row = batch.stage();
+    T *dst = batch.data.data() + batch.count;
+    char *isNull = batch.nulls.data() + batch.count;
+    size_t capacity = batch.capacity;
+    int stored = 0;
+    for (int c = 0; c < batch.cols; ++c)
+    {
+        const Deadband &b = f.bands[c];
+        bool keep = ((polled >> b.group) & 1) &&
+                    (!b.enabled || f.lastMs[c] < 0 || changed(row[c], f.last[c], b) ||
+                     (b.heartbeatMs > 0 && millis - f.lastMs[c] >= b.heartbeatMs));
+        dst[c * capacity] = row[c];
+        isNull[c * capacity] = !keep;
+        if (keep)
+        {
+            f.last[c] = row[c];
+            f.lastMs[c] = millis;
+            ++stored;
+        }
+    }
+    if (stored > 0)
+    {
+        batch.ts[batch.count++] = millis;
+        f.rowMs = millis;
+    }
+}
+
+// Commits a staged row that is known to equal the previous one. Filtered
+// columns can only be due a heartbeat; without any, the row is stored again
+// once `heartbeatMs` has passed since the last one, or always when it is 0.
+template <typename T>
+void commitUnchanged(ColumnBatch<T> &batch, ChangeFilter<T> &f, int64_t millis, int32_t heartbeatMs, uint64_t polled)
+{
+    if (!f.any && heartbeatMs > 0 && f.rowMs >= 0 && millis - f.rowMs < heartbeatMs)
+    {
+        return;
+    }
+    commitChanged(batch, f, millis, polled);
+}
+
+#endif // CHANGE_FILTER_H
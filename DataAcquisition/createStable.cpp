@@ -2,15 +2,21 @@
 #include <stdio.h>  // 包含 puts 函数的头文件
 #include <stdlib.h> // 包含 malloc 函数的头文件
 #include <assert.h>
+#include <string>
 #include "taos.h"
+#include "register_map.h"
+#include "easylogging++.h"
 
-#define ANALOG_COLS 307
-#define BOOL_COLS 560
 #define STABLE_NAME1 "Analog"
 #define STABLE_NAME2 "Bool"
+#define STABLE_NAME3 "Bits"
+#define STABLE_NAME4 "Raw"
+#define STABLE_NAME5 "Missed"
 
 TAOS *taos;
 
+INITIALIZE_EASYLOGGINGPP
+
 void clean()
 {
     taos_close(taos);
@@ -60,43 +66,93 @@ void executeSQL(const char *sql)
     taos_free_result(res);
 }
 
-void create_stable(int len, const char *tn, const char *type)
+void create_stable(int len, const char *tn, const char *type, const char *col = "c")
 {
-    int size = len * 12;
+    char stn[64];
+    snprintf(stn, sizeof(stn), "s_%s", tn);
+    executeSQL(("DROP STABLE IF EXISTS " + std::string(stn)).c_str());
+    // No columns of this kind, e.g. fewer than 16 bools to pack
+    if (len == 0)
+    {
+        return;
+    }
+
+    size_t size = len * (strlen(type) + 10);
     char *str2 = myMalloc<char>(size);
     memset(str2, 0, size);
     for (int i = 0; i < len; ++i)
     {
-        char num_str[16] = {0};
-        sprintf(num_str, "c%d %s,", i, type);
+        char num_str[64] = {0};
+        snprintf(num_str, sizeof(num_str), "%s%d %s,", col, i, type);
         assert((strlen(str2) + strlen(num_str) < size));
         strcat(str2, num_str);
     }
     str2[strlen(str2) - 1] = '\0';
 
     char *sql2 = myMalloc<char>(size + 100);
-    char stn[16] = "s_";
-    strcat(stn, tn);
-    sprintf(sql2, "DROP STABLE IF EXISTS %s", stn);
-    // taos_query_a(taos, sql2, select_callback, taos);
-    executeSQL(sql2);
-
-    memset(sql2, 0, size + 100);
     sprintf(sql2, "CREATE STABLE IF NOT EXISTS %s (ts TIMESTAMP, %s) TAGS (dev INT)", stn, str2);
     free(str2);
     executeSQL(sql2);
     free(sql2);
 }
 
-int main()
+// analog_storage "raw": the UINT16/INT16 registers as SMALLINT (UNSIGNED)
+// columns under their s_analog names, and one s_scale row per column telling
+// readers value = raw * scale + bias
+void create_raw_stable(const RegisterMap &map, const std::string &suffix)
 {
+    std::string cols;
+    std::string rows;
+    int n = 0;
+    for (const RegisterEntry &e : map.analogs)
+    {
+        if (e.words != 1)
+        {
+            continue;
+        }
+        char col[64];
+        snprintf(col, sizeof(col), ", c%d %s", e.col, e.type == REG_INT16 ? "SMALLINT" : "SMALLINT UNSIGNED");
+        cols += col;
+        char row[96];
+        snprintf(row, sizeof(row), " (now + %da, 'c%d', %.9g, 0)", n++, e.col, e.scale);
+        rows += row;
+    }
+    std::string stn = "s_" + std::string(STABLE_NAME4) + suffix;
+    executeSQL(("DROP STABLE IF EXISTS " + stn).c_str());
+    if (n == 0)
+    {
+        return;
+    }
+    executeSQL(("CREATE STABLE IF NOT EXISTS " + stn + " (ts TIMESTAMP" + cols + ") TAGS (dev INT)").c_str());
+
+    executeSQL("CREATE STABLE IF NOT EXISTS s_scale (ts TIMESTAMP, col BINARY(16), scale DOUBLE, bias DOUBLE) TAGS (tbl BINARY(64))");
+    std::string catalog = "scale_raw" + suffix;
+    executeSQL(("DROP TABLE IF EXISTS " + catalog).c_str());
+    executeSQL(("INSERT INTO " + catalog + " USING s_scale TAGS ('s_raw" + suffix + "') VALUES" + rows).c_str());
+}
+
+int main(int argc, char *argv[])
+{
+    const char *register_map = argc > 1 ? argv[1] : DEFAULT_REGISTER_MAP;
+    // Devices whose map differs from the default get their own supertables
+    std::string suffix = argc > 2 ? argv[2] : "";
+    RegisterMap map = loadRegisterMap(register_map);
+    DecodePlan plan = compileDecodePlan(map);
+
     const char *taos_ip = "127.0.0.1";
     const char *taos_username = "root";
     const char *taos_password = "taosdata";
     const char *taos_database = "test1";
     uint16_t taos_port = 6030;
     taosConn(taos_ip, taos_username, taos_password, taos_database, taos_port);
-    create_stable(ANALOG_COLS, STABLE_NAME1, "FLOAT");
-    create_stable(BOOL_COLS, STABLE_NAME2, "BOOL");
+    create_stable(plan.analogCols, (STABLE_NAME1 + suffix).c_str(), "FLOAT");
+    create_stable(plan.boolCols, (STABLE_NAME2 + suffix).c_str(), "BOOL");
+    // bool_storage "packed": bool column c is bit 15 - c % 16 of w<c / 16>
+    create_stable(plan.boolCols / 16, (STABLE_NAME3 + suffix).c_str(), "SMALLINT UNSIGNED", "w");
+    create_raw_stable(map, suffix);
+    // One row per poll that produced no frame, err the errno or libmodbus error
+    std::string missed = "s_" + std::string(STABLE_NAME5) + suffix;
+    executeSQL(("DROP STABLE IF EXISTS " + missed).c_str());
+    executeSQL(("CREATE STABLE IF NOT EXISTS " + missed + " (ts TIMESTAMP, err INT) TAGS (dev INT)").c_str());
     return 0;
 }
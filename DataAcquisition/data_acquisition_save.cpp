@@ -1,10 +1,33 @@
-#include <taskflow/taskflow.hpp>
 #include "gVal.h"
 #include "modbus_read.h"
+#include "modbus_engine.h"
+#include "device.h"
 #include "myTaos.h"
 #include "MQTTAsync_publish.h"
 #include "data_acquisition_save.h"
+#include "latest_frame.h"
+#include "live_publish.h"
 #include <inttypes.h>
+#include <set>
+#include <sys/stat.h>
+
+// Writes every metric to `file` and publishes them on `topic`; either may be
+// empty
+static void exportMetrics(const std::string &file, const std::string &topic, unsigned int qos)
+{
+    std::string text = metricsText();
+    if (!file.empty() && !metricsWriteFile(file, text))
+    {
+        printf("Failed to write metrics to %s: %s\n", file.c_str(), strerror(errno));
+        LOG(WARNING) << "Failed to write metrics to " << file << ": " << strerror(errno);
+    }
+    if (!topic.empty())
+    {
+        char *payload = new char[text.size() + 1];
+        memcpy(payload, text.c_str(), text.size() + 1);
+        myPublish(payload, topic.c_str(), qos);
+    }
+}
 
 int main(int argc, char *argv[])
 {
@@ -19,111 +42,218 @@ int main(int argc, char *argv[])
 
     json config_data;
     config_file >> config_data;
-    char *taos_ip = config_data["taos_ip"].dump().data();
-    removeQuotes(taos_ip);
-    char *taos_username = config_data["taos_user"].dump().data();
-    removeQuotes(taos_username);
-    char *taos_password = config_data["taos_pw"].dump().data();
-    removeQuotes(taos_password);
-    char *taos_database = config_data["taos_db"].dump().data();
-    removeQuotes(taos_database);
+    std::string taos_ip = config_data["taos_ip"].get<std::string>();
+    std::string taos_username = config_data["taos_user"].get<std::string>();
+    std::string taos_password = config_data["taos_pw"].get<std::string>();
+    std::string taos_database = config_data["taos_db"].get<std::string>();
     uint16_t taos_port = config_data["taos_port"];
 
-    char *modbus_ip = config_data["modbus_ip"].dump().data();
-    removeQuotes(modbus_ip);
-    int modbus_port = config_data["modbus_port"];
-    int modbus_slave_id = config_data["modbus_id"];
-
-    char *mqtt_address = config_data["mqtt_addr"].dump().data();
-    removeQuotes(mqtt_address);
-    char *mqtt_clientid = config_data["mqtt_id"].dump().data();
-    removeQuotes(mqtt_clientid);
-    char *mqtt_topic = config_data["mqtt_topic"].dump().data();
-    removeQuotes(mqtt_topic);
+    std::string mqtt_address = config_data["mqtt_addr"].get<std::string>();
+    std::string mqtt_clientid = config_data["mqtt_id"].get<std::string>();
+    std::string mqtt_topic = config_data["mqtt_topic"].get<std::string>();
     unsigned int mqtt_qos = config_data["mqtt_qos"];
+    int modbus_threads = config_data.value("modbus_threads", DEFAULT_ENGINE_THREADS);
+    int poll_period_ms = std::max(1, config_data.value("poll_period_ms", DEFAULT_POLL_PERIOD_MS));
+    int response_timeout_ms = config_data.value("response_timeout_ms", std::min(DEFAULT_RESPONSE_TIMEOUT_MS, poll_period_ms));
+    std::string overrun_policy = config_data.value("overrun_policy", std::string("skip"));
+    int reconnect_min_ms = std::max(1, config_data.value("reconnect_min_ms", DEFAULT_RECONNECT_MIN_MS));
+    int reconnect_max_ms = std::max(reconnect_min_ms, config_data.value("reconnect_max_ms", DEFAULT_RECONNECT_MAX_MS));
+    if (overrun_policy != "skip" && overrun_policy != "catch_up")
+    {
+        std::cerr << "overrun_policy must be \"skip\" or \"catch_up\"\n";
+        LOG(ERROR) << "overrun_policy must be \"skip\" or \"catch_up\"";
+        exit(EXIT_FAILURE);
+    }
+    int taos_writers = std::max(1, config_data.value("taos_writers", DEFAULT_TAOS_WRITERS));
+    std::string insert_engine = config_data.value("insert_engine", std::string("stmt"));
+    if (insert_engine != "stmt" && insert_engine != "schemaless")
+    {
+        std::cerr << "insert_engine must be \"stmt\" or \"schemaless\"\n";
+        LOG(ERROR) << "insert_engine must be \"stmt\" or \"schemaless\"";
+        exit(EXIT_FAILURE);
+    }
+    FlushPolicy flush;
+    flush.minRows = std::max(1, config_data.value("flush_min_rows", WRITE_INTERVAL));
+    flush.maxRows = std::max(flush.minRows, config_data.value("flush_max_rows", DEFAULT_FLUSH_MAX_ROWS));
+    flush.maxBytes = config_data.value("flush_max_bytes", (long)DEFAULT_FLUSH_MAX_BYTES);
+    flush.maxAgeMs = config_data.value("flush_max_age_ms", DEFAULT_FLUSH_MAX_AGE_MS);
+    std::string spool_dir = config_data.value("spool_dir", std::string(DEFAULT_SPOOL_DIR));
+    uint64_t spool_max_bytes = config_data.value("spool_max_bytes", (uint64_t)DEFAULT_SPOOL_MAX_BYTES);
+    SpoolOverflow spool_overflow = config_data.value("spool_overflow", std::string("drop_oldest")) == "drop_newest"
+                                       ? SPOOL_DROP_NEWEST : SPOOL_DROP_OLDEST;
+    int frame_slots = std::max(1, config_data.value("frame_queue_slots", DEVICE_FRAME_SLOTS));
+    int metrics_period_s = std::max(0, config_data.value("metrics_period_s", DEFAULT_METRICS_PERIOD_S));
+    std::string metrics_file = config_data.value("metrics_file", std::string());
+    std::string metrics_topic = config_data.value("metrics_topic", std::string());
+    std::string latest_shm = config_data.value("latest_shm", std::string());
+    int live_period_ms = std::max(0, config_data.value("live_period_ms", 0));
+    std::string live_topic = config_data.value("live_topic", mqtt_topic);
+    int live_keyframe_s = std::max(1, config_data.value("live_keyframe_s", DEFAULT_LIVE_KEYFRAME_S));
+    std::vector<Device> devices = loadDevices(config_data, taos_writers, frame_slots, flush.maxRows, poll_period_ms);
     config_file.close();
 
-    int device = 1;
-
-    taosConn(taos_ip, taos_username, taos_password, taos_database, taos_port);
-
-    modbusConn(modbus_ip, modbus_port, modbus_slave_id);
-
-    MQTTConn(mqtt_address, mqtt_clientid);
-
-    tf::Taskflow f1("F1");
-
-    tf::Task f1A = f1.emplace([&]() {
-        modbusReadData = read_registers(START_REGISTERS, NB_REGISTERS);
-    }).name("modbus_read");
-
-    tf::Task f1B = f1.emplace([&]() {
-        readAnalogs = extractAnalog(modbusReadData);
-        saveDatum(readAnalogs, ANALOG_COLS, gAnalogs);
-        auto now = std::chrono::system_clock::now();
-        auto duration = now.time_since_epoch();
-        auto millis = std::chrono::duration_cast<std::chrono::milliseconds>(duration).count();
-        timestampsA.push_back(millis);
-    }).name("extract&save_analogs");
+    std::set<std::string> printed;
+    for (const Device &d : devices)
+    {
+        if (printed.insert(d.registerMap).second)
+        {
+            printf("Register map %s:\n", d.registerMap.c_str());
+            printDecodePlan(d.plan);
+            printReadPlan(d.reads, d.plan);
+        }
+    }
+    printDevices(devices);
 
-    tf::Task f1C = f1.emplace([&]() {
-        readBools = extractBool(modbusReadData);
-        saveDatum(readBools, BOOL_COLS, gBools);
-        auto now = std::chrono::system_clock::now();
-        auto duration = now.time_since_epoch();
-        auto millis = std::chrono::duration_cast<std::chrono::milliseconds>(duration).count();
-        timestampsB.push_back(millis);
-    }).name("extract&save_bools");
+    // The latest frame of each device, for live publishing and, in shared
+    // memory <latest_shm>_<id>, for local readers (latest_frame.h)
+    bool keep_latest = !latest_shm.empty() || live_period_ms > 0;
+    std::vector<LatestFrame> latest(keep_latest ? devices.size() : 0);
+    for (size_t i = 0; i < latest.size(); ++i)
+    {
+        const Device &d = devices[i];
+        std::string name = latest_shm.empty() ? "memory" : latest_shm + "_" + std::to_string(d.id);
+        if (latestCreate(&latest[i], latest_shm.empty() ? NULL : name.c_str(), d.id, d.plan.analogCols,
+                         d.plan.boolCols) != 0)
+        {
+            printf("Failed to create latest frame %s: %s\n", name.c_str(), strerror(errno));
+            LOG(ERROR) << "Failed to create latest frame " << name << ": " << strerror(errno);
+            exit(EXIT_FAILURE);
+        }
+    }
 
-    tf::Task f1D = f1.emplace([&]() {
-        free(modbusReadData);
-    }).name("save_timestamps");
+    MQTTConn(mqtt_address.c_str(), mqtt_clientid.c_str());
 
-    tf::Task f1E = f1.emplace([&] {
-        if (gAnalogs.size() >= WRITE_INTERVAL) 
+    // Each writer owns a TDengine connection and the devices hashed to it, so
+    // inserts for different devices run in parallel. Each also has its own
+    // spool file for the rows it cannot insert.
+    if (spool_max_bytes > 0 && mkdir(spool_dir.c_str(), 0755) != 0 && errno != EEXIST)
+    {
+        printf("Failed to create spool directory %s: %s\n", spool_dir.c_str(), strerror(errno));
+        LOG(ERROR) << "Failed to create spool directory " << spool_dir << ": " << strerror(errno);
+        clean();
+        exit(EXIT_FAILURE);
+    }
+    std::vector<std::unique_ptr<WriterShard>> writers;
+    for (int i = 0; i < taos_writers; ++i)
+    {
+        writers.emplace_back(new WriterShard());
+        WriterShard &w = *writers.back();
+        w.id = i;
+        w.login = {taos_ip, taos_username, taos_password, taos_database, taos_port};
+        w.engine = insert_engine == "schemaless" ? INSERT_SCHEMALESS : INSERT_STMT;
+        w.conn = taosTryConnect(taos_ip.c_str(), taos_username.c_str(), taos_password.c_str(), taos_database.c_str(), taos_port);
+        w.retryMs = 0;
+        w.retryAt = 0;
+        w.lostBatches = 0;
+        w.rejectedBatches = 0;
+        if (spool_max_bytes > 0)
         {
-            newInsert(gAnalogs, timestampsA, ANALOG_COLS, device, "analog", std::string("FLOAT"));
-            gAnalogs.erase(gAnalogs.begin(), gAnalogs.begin() + WRITE_INTERVAL);
-            timestampsA.erase(timestampsA.begin(), timestampsA.begin() + WRITE_INTERVAL);
+            std::string path = spool_dir + "/writer" + std::to_string(i) + ".spool";
+            spoolOpen(w.spool, path.c_str(), spool_max_bytes, spool_overflow);
         }
-    }).name("insert_analogs");
+        sem_init(&w.ready, 0, 0);
+        w.policy = flush;
+    }
+    for (size_t i = 0; i < devices.size(); ++i)
+    {
+        writers[devices[i].shard]->devices.push_back((int)i);
+    }
 
-    tf::Task f1F = f1.emplace([&] {
-        if (gAnalogs.size() >= WRITE_INTERVAL) 
+    // The engine polls every PLC on its own threads and queues each complete
+    // frame on the device's ring for the writer that owns it
+    ModbusEngine engine;
+    engine.periodMs = poll_period_ms;
+    engine.responseTimeoutMs = response_timeout_ms;
+    engine.overrun = overrun_policy == "catch_up" ? OVERRUN_CATCH_UP : OVERRUN_SKIP;
+    engine.reconnectMinMs = reconnect_min_ms;
+    engine.reconnectMaxMs = reconnect_max_ms;
+    LatencyHistogram &cycleLatency = metricHistogram("modbus_cycle");
+    MetricCounter &framesPolled = metricCounter("modbus_frames");
+    MetricCounter &pollsMissed = metricCounter("modbus_missed");
+    engine.onFrame = [&](const ModbusSession &s, const uint16_t *c, int64_t millis) {
+        Device &d = devices[s.id];
+        cycleLatency.record(metricsNowNs() - s.cycleStartNs);
+        framesPolled.add();
+        if (!latest.empty())
         {
-            newInsert(gBools, timestampsB, BOOL_COLS, device, "bool", std::string("BOOL"));
-            gBools.erase(gBools.begin(), gBools.begin() + WRITE_INTERVAL);
-            timestampsB.erase(timestampsB.begin(), timestampsB.begin() + WRITE_INTERVAL);
+            // Only a frame with new register values needs decoding again
+            LatestFrame &f = latest[s.id];
+            latestBeginWrite(&f);
+            if (s.changedReads != 0)
+            {
+                decodeAnalog(d.plan, c, f.analogs);
+                decodeBool(d.plan, c, f.bools);
+            }
+            latestEndWrite(&f, millis);
         }
-    }).name("insert_bools");
-
-    f1A.precede(f1B, f1C);
-    f1D.succeed(f1B, f1C);
+        queueFrame(*writers[d.shard], d, c, millis, s.changedReads, s.polledGroups);
+    };
+    engine.onMissed = [&](const ModbusSession &s, int64_t millis, int err) {
+        Device &d = devices[s.id];
+        pollsMissed.add();
+        queueMissed(*writers[d.shard], d, millis, err);
+    };
+    for (const Device &d : devices)
+    {
+        engineAddSession(engine, {d.ip, d.port, d.standbyIp, d.standbyPort, d.slave, d.reads, d.groupEvery,
+                                  d.plan.frameWords, d.window});
+    }
 
-    tf::Taskflow f3("F3");
+    // Live values go to <live_topic>/<id> straight from the latest frames,
+    // never through TDengine
+    LivePublisher live;
+    live.periodMs = live_period_ms;
+    live.keyframeMs = live_keyframe_s * 1000;
+    LatencyHistogram &publishLatency = metricHistogram("mqtt_publish");
+    live.send = [&](const std::string &topic, const char *payload, int len) {
+        int64_t start = metricsNowNs();
+        myPublishBytes(payload, len, topic.c_str(), mqtt_qos);
+        publishLatency.record(metricsNowNs() - start);
+    };
+    for (size_t i = 0; live_period_ms > 0 && i < devices.size(); ++i)
+    {
+        const Device &d = devices[i];
+        liveAdd(live, d.id, latest[i], d.plan.analogBands, live_topic + "/" + std::to_string(d.id));
+    }
 
-    tf::Task f3A = f3.emplace([&] {
-        char *str = myQuery();
-        myPublish(str, mqtt_topic, mqtt_qos);
-    }).name("publish");
-    
-    tf::Executor executor;
+    for (auto &w : writers)
+    {
+        WriterShard *shard = w.get();
+        shard->thread = std::thread([shard, &devices] { runWriter(*shard, devices); });
+    }
+    engineStart(engine, modbus_threads);
+    if (live_period_ms > 0)
+    {
+        liveStart(live);
+    }
+    MetricGauge &framesQueued = metricGauge("frames_queued");
+    PollSchedule tick;
+    scheduleStart(tick, monotonicNs(), 1000000000, OVERRUN_SKIP);
     int count = 0;
     while (1)
     {
-        auto start = std::chrono::steady_clock::now();
-
-        executor.run(f1).wait();
-        // if (count % 5 == 0) {
-        //     executor.run(f3).wait();
-        // }
-
-        auto end = std::chrono::steady_clock::now();
-        auto elapsed_time = std::chrono::duration_cast<std::chrono::microseconds>(end - start);
-        printf("Loop %d time used: %ld microseconds\n", ++count, elapsed_time.count());
-        std::this_thread::sleep_for(std::chrono::microseconds(1000000 - elapsed_time.count()));
+        sleepUntil(tick.next);
+        scheduleFire(tick, monotonicNs());
+        ++count;
+        if (count % WRITER_REPORT_PERIOD == 0)
+        {
+            reportWriters(writers, devices);
+            engineReport(engine);
+        }
+        if (metrics_period_s > 0 && count % metrics_period_s == 0 && (!metrics_file.empty() || !metrics_topic.empty()))
+        {
+            int64_t queued = 0;
+            for (const Device &d : devices)
+            {
+                queued += d.frames->depth();
+            }
+            framesQueued.set(queued);
+            exportMetrics(metrics_file, metrics_topic, mqtt_qos);
+        }
     }
 
+    liveStop(live);
+    engineStop(engine);
     clean();
     return 0;
-}
\ No newline at end of file
+}
@@ -2,23 +2,43 @@
 #define DATA_ACQUISITION_SAVE_H
 
 // #include "gVal.h"
+#include <map>
+#include <semaphore.h>
+#include "device.h"
+#include "modbus_engine.h"
+#include "alloc_counter.h"
+#include "metrics.h"
+#include "spool.h"
+#include "line_protocol.h"
 
 #define LOG_FILE_NAME "logs/info.%datetime{%Y%M%d}.log"
 #define MAX_LOG_FILE_SIZE "1000000"
 #define WRITE_INTERVAL 10
 
-uint16_t *modbusReadData;
-uint8_t *readBools;
-float *readAnalogs;
-std::vector<uint64_t> timestampsA;
-std::vector<uint64_t> timestampsB;
-std::vector<std::vector<float>> gAnalogs;
-std::vector<std::vector<uint8_t>> gBools;
+// A device's rows are inserted once any limit is hit
+#define DEFAULT_FLUSH_MAX_ROWS 120
+#define DEFAULT_FLUSH_MAX_BYTES (1 << 20)
+#define DEFAULT_FLUSH_MAX_AGE_MS 10000
+// Share of a writer's time spent inserting above which batches double, and
+// below which they shrink back towards the minimum, checked every window
+#define FLUSH_BUSY_HIGH 0.5
+#define FLUSH_BUSY_LOW 0.2
+#define FLUSH_ADAPT_WINDOW_MS 5000
+// Seconds between writer queue reports
+#define WRITER_REPORT_PERIOD 60
+// Seconds between metrics exports, see metrics.h
+#define DEFAULT_METRICS_PERIOD_S 10
+// Reconnect backoff while TDengine is unreachable, doubling from min to max
+#define TAOS_RETRY_MIN_MS 1000
+#define TAOS_RETRY_MAX_MS 30000
+// Longest stretch spent replaying the spool before draining frames again
+#define SPOOL_REPLAY_SLICE_MS 200
 
 std::unordered_map<std::string, int> typeMap = {
     {"BOOL", TSDB_DATA_TYPE_BOOL},
     {"FLOAT", TSDB_DATA_TYPE_FLOAT},
-    {"INT", TSDB_DATA_TYPE_INT}
+    {"INT", TSDB_DATA_TYPE_INT},
+    {"USMALLINT", TSDB_DATA_TYPE_USMALLINT}
 };
 
 INITIALIZE_EASYLOGGINGPP
@@ -51,103 +71,954 @@ void setLogger()
     LOG(INFO) << "--------The program has started--------";
 }
 
-template <typename T>
-void saveDatum(T *readData, int cols, std::vector<std::vector<T>>& saveData)
+// How a writer gets rows into TDengine; both take the same batches
+enum InsertEngine
 {
-    std::vector<T> bools_vector(readData, readData + cols);
-    saveData.push_back(bools_vector);
-    free(readData);
-}
+    INSERT_STMT,      // prepared INSERT ... USING with every column bound, newInsert
+    INSERT_SCHEMALESS // line protocol through taos_schemaless_insert, linesInsert
+};
 
-template <typename T>
-void newInsert(std::vector<std::vector<T>>& data, std::vector<uint64_t>& ts, int len, int dev, const char *taosTableName, const std::string& type)
+struct FlushPolicy
+{
+    int minRows = WRITE_INTERVAL;
+    int maxRows = DEFAULT_FLUSH_MAX_ROWS;
+    long maxBytes = DEFAULT_FLUSH_MAX_BYTES;
+    int maxAgeMs = DEFAULT_FLUSH_MAX_AGE_MS;
+};
+
+// INSERT INTO ? USING <supertable> TAGS(?) [(ts, <columns>)] VALUES(?, ...),
+// prepared once per writer connection and reused for the process lifetime
+struct StmtWriter
+{
+    TAOS_STMT *stmt;
+    std::vector<TAOS_MULTI_BIND> values;
+    TAOS_MULTI_BIND tags[1];
+    int dev;
+};
+
+// Kinds of rows a device inserts: analog, raw, bool, bits and missed
+#define INSERT_KINDS 5
+
+static int kindSlot(const char *kind)
 {
-    char *str1 = myMalloc<char>(len * 2 + 1);
-    int j = 0;
-    for (int i = 0; i < len; ++i, j += 2)
+    static const char *kinds[INSERT_KINDS] = {"analog", "raw", "bool", "bits", "missed"};
+    int i = 0;
+    while (i < INSERT_KINDS - 1 && strcmp(kind, kinds[i]) != 0)
     {
-        str1[j] = '?';
-        str1[j + 1] = ',';
+        ++i;
     }
+    return i;
+}
+
+// What a writer prepared for each kind of a device's rows, so a flush
+// neither builds the SQL or line schema nor looks it up
+struct DeviceInserts
+{
+    StmtWriter *stmts[INSERT_KINDS] = {};
+    LineSchema *lines[INSERT_KINDS] = {};
+};
+
+struct TaosLogin
+{
+    std::string ip;
+    std::string user;
+    std::string password;
+    std::string database;
+    uint16_t port;
+};
 
-    str1[j - 1] = '\0';
-    char stn[16] = "s_";
-    strcat(stn, taosTableName);
+// Rows of one device as spooled: the header, then for the analog, the bool,
+// the packed bool, the raw and the missed batch its timestamps, columns and
+// NULL masks
+struct SpoolBatch
+{
+    int32_t device;
+    int32_t analogRows;
+    int32_t boolRows;
+    int32_t analogCols;
+    int32_t boolCols;
+    int32_t bitRows;
+    int32_t bitCols;
+    int32_t rawRows;
+    int32_t rawCols;
+    int32_t missedRows;
+};
 
-    char *sql1 = myMalloc<char>(len * 2 + 100);
-    sprintf(sql1, "INSERT INTO ? USING %s TAGS(?) VALUES(?, %s)", stn, str1);
-    free(str1);
+// One TDengine connection and the devices hashed to it. Frames of a device
+// always go to the same writer, so its row buffers need no locking. Engine
+// threads post `ready` after publishing a frame to one of its devices' rings.
+// While TDengine is down (conn NULL) or the spool still holds older rows,
+// flushed rows are appended to the spool instead, and replayed in order once
+// the connection is back.
+struct WriterShard
+{
+    int id;
+    TAOS *conn;
+    TaosLogin login;
+    Spool spool;          // not open when spooling is disabled
+    int64_t retryAt;      // steady ms of the next reconnect
+    int retryMs;
+    uint64_t lostBatches; // neither inserted nor spooled
+    uint64_t rejectedBatches; // refused by TDengine and dropped
+    int insertError;      // TDengine code of the last failed insert
+    ColumnBatch<float> replayAnalogs;
+    ColumnBatch<uint8_t> replayBools;
+    ColumnBatch<uint16_t> replayBits;
+    ColumnBatch<uint16_t> replayRaws;
+    ColumnBatch<int32_t> replayMissed;
+    SubtableName replayAnalogTable;
+    SubtableName replayBoolTable;
+    SubtableName replayBitTable;
+    SubtableName replayRawTable;
+    SubtableName replayMissedTable;
+    sem_t ready;
+    std::thread thread;
+    std::vector<int> devices;
+    InsertEngine engine = INSERT_STMT;
+    std::map<std::string, std::unique_ptr<StmtWriter>> stmts; // by SQL, shared by devices of a supertable
+    std::unordered_map<int, DeviceInserts> inserts;           // by device id
+    std::map<std::string, std::unique_ptr<LineSchema>> lineSchemas; // by supertable and columns
+    LineBuffer lines;
+    FlushPolicy policy;
+    int rows;             // current flush size, between policy.minRows and maxRows
+    int64_t windowStart;  // steady ms
+    int64_t busyMicros;   // spent inserting since windowStart
+};
+
+// NULL if the statement cannot be prepared. Binds every column of the
+// supertable in order, or only `names` when given; `types` overrides
+// bufferType per column.
+StmtWriter *stmtFor(WriterShard &shard, const char *kind, const std::string &stable, int cols, int bufferType, int size,
+                    const std::vector<std::string> &names, const std::vector<int> &types)
+{
+    std::string sql = "INSERT INTO ? USING s_" + std::string(kind) + stable + " TAGS(?)";
+    if (!names.empty())
+    {
+        sql += " (ts";
+        for (const std::string &name : names)
+        {
+            sql += "," + name;
+        }
+        sql += ")";
+    }
+    sql += " VALUES(?";
+    for (int i = 0; i < cols; ++i)
+    {
+        sql += ",?";
+    }
+    sql += ")";
 
-    TAOS_STMT *stmt = taos_stmt_init(taos);
-    int code = taos_stmt_prepare(stmt, sql1, 0);
-    free(sql1);
-    checkErrorCode(stmt, code, "failed to execute taos_stmt_prepare");
+    std::unique_ptr<StmtWriter> &w = shard.stmts[sql];
+    if (w)
+    {
+        return w.get();
+    }
+    w.reset(new StmtWriter());
+    w->stmt = taos_stmt_init(shard.conn);
+    int code = taos_stmt_prepare(w->stmt, sql.c_str(), 0);
+    if (!stmtOk(w->stmt, code, "failed to execute taos_stmt_prepare"))
+    {
+        shard.insertError = code;
+        taos_stmt_close(w->stmt);
+        shard.stmts.erase(sql);
+        return NULL;
+    }
 
-    TAOS_MULTI_BIND tags[1];
-    tags[0].buffer_type = TSDB_DATA_TYPE_INT;
-    tags[0].buffer_length = sizeof(int);
-    tags[0].is_null = NULL;
-    tags[0].buffer = &dev;
-
-    TAOS_MULTI_BIND *values = new TAOS_MULTI_BIND[len + 1];
-    values[0].buffer_type = TSDB_DATA_TYPE_TIMESTAMP;
-    values[0].buffer_length = sizeof(int64_t);
-    values[0].is_null = NULL;
-    values[0].num = 1;
-
-    int insertNums = WRITE_INTERVAL;
-    long long now;
-    time_t t;
-    struct tm *tm_now;
-    char buf[64];
-    char tableName[100];
+    w->tags[0].buffer_type = TSDB_DATA_TYPE_INT;
+    w->tags[0].buffer = &w->dev;
+    w->tags[0].buffer_length = sizeof(int);
+    w->tags[0].length = NULL;
+    w->tags[0].is_null = NULL;
+    w->tags[0].num = 1;
 
+    w->values.resize(cols + 1);
+    w->values[0].buffer_type = TSDB_DATA_TYPE_TIMESTAMP;
+    w->values[0].buffer_length = sizeof(int64_t);
+    w->values[0].length = NULL;
+    w->values[0].is_null = NULL;
+    for (int j = 1; j < cols + 1; ++j)
+    {
+        w->values[j].buffer_type = types.empty() ? bufferType : types[j - 1];
+        w->values[j].buffer_length = size;
+        w->values[j].length = NULL;
+        w->values[j].is_null = NULL;
+    }
+    return w.get();
+}
+
+// Inserts every row of `data` into the device's daily subtables of supertable
+// s_<kind><stable>. Each column is bound once for all rows of a day
+// (num = rows), so a batch costs about as much as a single row. False if
+// TDengine refused any step. `columns` and `types` as for stmtFor.
+template <typename T>
+bool newInsert(WriterShard &shard, ColumnBatch<T>& data, SubtableName &names, const Device &d, const char *kind, const std::string& type,
+               const std::vector<std::string> &columns = std::vector<std::string>(), const std::vector<int> &types = std::vector<int>())
+{
     int bufferType{0};
     auto iter = typeMap.find(type);
     if (iter != typeMap.end())
     {
         bufferType = iter->second;
     }
+    StmtWriter *&stmt = shard.inserts[d.id].stmts[kindSlot(kind)];
+    if (stmt == NULL)
+    {
+        stmt = stmtFor(shard, kind, d.stable, data.cols, bufferType, sizeof(T), columns, types);
+    }
+    if (stmt == NULL)
+    {
+        return false;
+    }
+    StmtWriter &w = *stmt;
+    w.dev = d.id;
+    static LatencyHistogram &bindLatency = metricHistogram("taos_bind");
+    static LatencyHistogram &executeLatency = metricHistogram("taos_stmt_execute");
+    static MetricCounter &rowsInserted = metricCounter("taos_rows");
+    int64_t bindStart = metricsNowNs();
 
-    for (int i = 0; i < insertNums; i++)
+    int code;
+    int start = 0;
+    while (start < data.count)
     {
-        now = ts[i];
-        t = now / 1000;
-        tm_now = localtime(&t);
-        memset(buf, 0, 64);
-        strftime(buf, 64, "%Y%m%d", tm_now);
-        memset(tableName, 0, 100);
-        sprintf(tableName, "%s%s", taosTableName, buf);
+        // Rows of one day share a subtable; a batch spans two only at midnight
+        const char *tableName = subtableName(names, d.table, kind, data.ts[start]);
+        int end = start + 1;
+        while (end < data.count && data.ts[end] >= names.from && data.ts[end] < names.to)
+        {
+            ++end;
+        }
 
-        code = taos_stmt_set_tbname_tags(stmt, tableName, tags);
-        checkErrorCode(stmt, code, "failed to execute taos_stmt_set_tbname_tags");
+        code = taos_stmt_set_tbname_tags(w.stmt, tableName, w.tags);
+        if (!stmtOk(w.stmt, code, "failed to execute taos_stmt_set_tbname_tags"))
+        {
+            shard.insertError = code;
+            return false;
+        }
 
-        values[0].buffer = &now;
+        w.values[0].buffer = &data.ts[start];
+        w.values[0].num = end - start;
+        for (int j = 1; j < data.cols + 1; ++j)
+        {
+            w.values[j].buffer = data.column(j - 1) + start;
+            w.values[j].is_null = data.nulls.data() + (size_t)(j - 1) * data.capacity + start;
+            w.values[j].num = end - start;
+        }
+
+        code = taos_stmt_bind_param_batch(w.stmt, w.values.data());
+        if (!stmtOk(w.stmt, code, "failed to execute taos_stmt_bind_param_batch"))
+        {
+            shard.insertError = code;
+            return false;
+        }
 
-        for (int j = 1; j < len + 1; ++j)
+        code = taos_stmt_add_batch(w.stmt);
+        if (!stmtOk(w.stmt, code, "failed to execute taos_stmt_add_batch"))
         {
-            values[j].buffer_type = bufferType;
-            values[j].buffer = &data[i][j - 1];
-            values[j].buffer_length = sizeof(T);
-            values[j].is_null = NULL;
-            values[j].num = 1;
+            shard.insertError = code;
+            return false;
         }
+        start = end;
+    }
+
+    int64_t executeStart = metricsNowNs();
+    bindLatency.record(executeStart - bindStart);
+    code = taos_stmt_execute(w.stmt);
+    executeLatency.record(metricsNowNs() - executeStart);
+    if (!stmtOk(w.stmt, code, "failed to execute taos_stmt_execute"))
+    {
+        shard.insertError = code;
+        return false;
+    }
+    rowsInserted.add(data.count);
+    return true;
+}
+
+LineSchema &lineSchemaFor(WriterShard &shard, const char *kind, const std::string &stable, int cols, int type,
+                          const std::vector<std::string> &names, const std::vector<int> &types)
+{
+    std::string key = std::string(kind) + stable;
+    for (const std::string &name : names)
+    {
+        key += "," + name;
+    }
+    std::unique_ptr<LineSchema> &s = shard.lineSchemas[key];
+    if (!s)
+    {
+        s.reset(new LineSchema());
+        lineSchema(*s, kind, stable, cols, type, names, types);
+    }
+    return *s;
+}
+
+// Inserts the same rows as newInsert as line protocol (line_protocol.h),
+// formatted in place into the writer's buffer and sent in one
+// taos_schemaless_insert. NULL columns are left out of the lines instead of
+// being bound, so filtered rows cost what they hold. TDengine creates the
+// supertables, columns and daily subtables (tname tag) the lines need; its
+// `dev` tag is NCHAR, so these cannot be the INT-tagged supertables
+// createStable makes for the statement engine.
+template <typename T>
+bool linesInsert(WriterShard &shard, ColumnBatch<T> &data, SubtableName &names, const Device &d, const char *kind, const std::string &type,
+                 const std::vector<std::string> &columns = std::vector<std::string>(), const std::vector<int> &types = std::vector<int>())
+{
+    LineSchema *&schema = shard.inserts[d.id].lines[kindSlot(kind)];
+    if (schema == NULL)
+    {
+        auto iter = typeMap.find(type);
+        schema = &lineSchemaFor(shard, kind, d.stable, data.cols, iter != typeMap.end() ? iter->second : 0, columns, types);
+    }
+    static LatencyHistogram &formatLatency = metricHistogram("taos_format");
+    static LatencyHistogram &insertLatency = metricHistogram("taos_schemaless_insert");
+    static MetricCounter &rowsInserted = metricCounter("taos_rows");
 
-        code = taos_stmt_bind_param(stmt, values);
-        checkErrorCode(stmt, code, "failed to execute taos_stmt_bind_param");
+    int64_t formatStart = metricsNowNs();
+    int n = formatLines(shard.lines, *schema, data, names, d.table, kind, d.id);
+    int64_t insertStart = metricsNowNs();
+    formatLatency.record(insertStart - formatStart);
+    if (n == 0)
+    {
+        return true;
+    }
+    TAOS_RES *res = taos_schemaless_insert(shard.conn, shard.lines.lines.data(), n, TSDB_SML_LINE_PROTOCOL,
+                                           TSDB_SML_TIMESTAMP_MILLI_SECONDS);
+    insertLatency.record(metricsNowNs() - insertStart);
+    int code = taos_errno(res);
+    if (!resultOk(res, "failed to execute taos_schemaless_insert"))
+    {
+        shard.insertError = code;
+        return false;
+    }
+    rowsInserted.add(n);
+    return true;
+}
+
+// The writer's insert engine
+template <typename T>
+bool insertBatch(WriterShard &shard, ColumnBatch<T> &data, SubtableName &names, const Device &d, const char *kind, const std::string &type,
+                 const std::vector<std::string> &columns = std::vector<std::string>(), const std::vector<int> &types = std::vector<int>())
+{
+    if (shard.engine == INSERT_SCHEMALESS)
+    {
+        return linesInsert(shard, data, names, d, kind, type, columns, types);
+    }
+    return newInsert(shard, data, names, d, kind, type, columns, types);
+}
+
+static int64_t writerSteadyMs()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static int64_t writerWallMs()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+template <typename T>
+static int64_t oldestRow(const ColumnBatch<T> &b, int64_t oldest)
+{
+    return b.count == 0 ? oldest : std::min(oldest, b.ts[0]);
+}
+
+// Time of the oldest buffered row; filtered rows can leave any batch empty
+static int64_t oldestRow(const Device &d)
+{
+    return oldestRow(d.missed, oldestRow(d.raws, oldestRow(d.bits, oldestRow(d.bools, oldestRow(d.analogs, INT64_MAX)))));
+}
+
+template <typename T>
+static long batchBytes(const ColumnBatch<T> &b)
+{
+    return (long)b.count * (b.cols * sizeof(T) + sizeof(int64_t));
+}
+
+static bool flushDue(const WriterShard &shard, const Device &d, int64_t now)
+{
+    int rows = std::max(std::max(d.analogs.count, d.raws.count), std::max(d.bools.count, d.bits.count));
+    rows = std::max(rows, d.missed.count);
+    long bytes = batchBytes(d.analogs) + batchBytes(d.raws) + batchBytes(d.bools) + batchBytes(d.bits) + batchBytes(d.missed);
+    return rows > 0 && (rows >= shard.rows || rows == d.analogs.capacity || bytes >= shard.policy.maxBytes ||
+                        now - oldestRow(d) >= shard.policy.maxAgeMs);
+}
+
+// Larger batches when inserting takes over half the writer's time, smaller
+// ones (lower data latency) when it is mostly idle
+static void adaptFlush(WriterShard &shard, int64_t now)
+{
+    int64_t window = now - shard.windowStart;
+    if (window < FLUSH_ADAPT_WINDOW_MS)
+    {
+        return;
+    }
+    double busy = shard.busyMicros / (window * 1000.0);
+    int rows = shard.rows;
+    if (busy > FLUSH_BUSY_HIGH)
+    {
+        rows = std::min(shard.policy.maxRows, rows * 2);
+    }
+    else if (busy < FLUSH_BUSY_LOW)
+    {
+        rows = std::max(shard.policy.minRows, rows * 3 / 4);
+    }
+    if (rows != shard.rows)
+    {
+        printf("Writer busy %.0f%%, flushing every %d rows\n", busy * 100, rows);
+        LOG(INFO) << "Writer busy " << (int)(busy * 100) << "%, flushing every " << rows << " rows";
+        shard.rows = rows;
+    }
+    shard.windowStart = now;
+    shard.busyMicros = 0;
+}
+
+static bool insertRows(WriterShard &shard, const Device &d, ColumnBatch<float> &analogs, ColumnBatch<uint16_t> &raws,
+                       ColumnBatch<uint8_t> &bools, ColumnBatch<uint16_t> &bits, ColumnBatch<int32_t> &missed,
+                       SubtableName &analogTable, SubtableName &rawTable, SubtableName &boolTable, SubtableName &bitTable,
+                       SubtableName &missedTable)
+{
+    return (analogs.count == 0 || insertBatch(shard, analogs, analogTable, d, "analog", std::string("FLOAT"), d.analogNames)) &&
+           (raws.count == 0 || insertBatch(shard, raws, rawTable, d, "raw", std::string("USMALLINT"), d.rawNames, d.rawTypes)) &&
+           (bools.count == 0 || insertBatch(shard, bools, boolTable, d, "bool", std::string("BOOL"))) &&
+           (bits.count == 0 || insertBatch(shard, bits, bitTable, d, "bits", std::string("USMALLINT"))) &&
+           (missed.count == 0 || insertBatch(shard, missed, missedTable, d, "missed", std::string("INT")));
+}
 
-        code = taos_stmt_add_batch(stmt);
-        checkErrorCode(stmt, code, "failed to execute taos_stmt_add_batch");
+static bool spoolPending(const WriterShard &shard)
+{
+    return shard.spool.base != NULL && !spoolEmpty(shard.spool);
+}
+
+static void retryLater(WriterShard &shard)
+{
+    shard.retryMs = shard.retryMs == 0 ? TAOS_RETRY_MIN_MS : std::min(shard.retryMs * 2, TAOS_RETRY_MAX_MS);
+    shard.retryAt = writerSteadyMs() + shard.retryMs;
+}
+
+// Statements are prepared again on their next insert
+static void closeStmts(WriterShard &shard)
+{
+    for (auto &kv : shard.stmts)
+    {
+        taos_stmt_close(kv.second->stmt);
+    }
+    shard.stmts.clear();
+    for (auto &kv : shard.inserts)
+    {
+        std::fill(kv.second.stmts, kv.second.stmts + INSERT_KINDS, nullptr);
     }
-    delete[] values;
+}
+
+// Drops the connection and its statements; runWriter reconnects with backoff
+static void writerDown(WriterShard &shard)
+{
+    closeStmts(shard);
+    taos_close(shard.conn);
+    shard.conn = NULL;
+    retryLater(shard);
+    printf("Writer %d: TDengine unavailable, %s, reconnecting in %d ms\n", shard.id,
+           shard.spool.base != NULL ? "spooling rows" : "dropping rows", shard.retryMs);
+    LOG(WARNING) << "Writer " << shard.id << ": TDengine unavailable, "
+                 << (shard.spool.base != NULL ? "spooling rows" : "dropping rows") << ", reconnecting in " << shard.retryMs << " ms";
+}
 
-    code = taos_stmt_execute(stmt);
-    checkErrorCode(stmt, code, "failed to execute taos_stmt_execute");
+// After a failed insert of `d`'s rows: true if TDengine is unreachable, and
+// the writer is taken down so rows wait in the spool. Rows it refused (a
+// schema mismatch, a missing supertable, a tag type conflict, a bad value)
+// would be refused again on every retry and hold up the rows behind them,
+// so they are counted, logged and dropped; statements are prepared afresh,
+// as a failed one may still hold part of the batch.
+static bool insertUnavailable(WriterShard &shard, const Device &d)
+{
+    if (taosUnreachable(shard.insertError))
+    {
+        writerDown(shard);
+        return true;
+    }
+    static MetricCounter &rejected = metricCounter("taos_rejected_batches");
+    rejected.add(1);
+    ++shard.rejectedBatches;
+    closeStmts(shard);
+    printf("Writer %d: TDengine refused rows of device %d (code 0x%x), %lu batches dropped\n", shard.id, d.id,
+           (unsigned)shard.insertError, (unsigned long)shard.rejectedBatches);
+    LOG(ERROR) << "Writer " << shard.id << ": TDengine refused rows of device " << d.id << " (code 0x" << std::hex
+               << (unsigned)shard.insertError << std::dec << "), " << shard.rejectedBatches << " batches dropped";
+    return false;
+}
 
-    int affectedRows = taos_stmt_affected_rows(stmt);
-    printf("successfully inserted dev:%d, table:%s, %d rows\n", dev, taosTableName, affectedRows);
+template <typename T>
+static size_t spooledSize(int rows, int cols)
+{
+    return (size_t)rows * (sizeof(int64_t) + cols * (sizeof(T) + 1));
+}
 
-    taos_stmt_close(stmt);
+template <typename T>
+static char *spoolColumns(char *p, const ColumnBatch<T> &b)
+{
+    memcpy(p, b.ts.data(), b.count * sizeof(int64_t));
+    p += b.count * sizeof(int64_t);
+    for (int c = 0; c < b.cols; ++c)
+    {
+        memcpy(p, &b.data[(size_t)c * b.capacity], b.count * sizeof(T));
+        p += b.count * sizeof(T);
+    }
+    for (int c = 0; c < b.cols; ++c)
+    {
+        memcpy(p, &b.nulls[(size_t)c * b.capacity], b.count);
+        p += b.count;
+    }
+    return p;
+}
+
+// Spooled columns are packed, i.e. laid out as a batch whose capacity is rows
+template <typename T>
+static const char *unspoolColumns(const char *p, ColumnBatch<T> &b, int cols, int rows)
+{
+    b.init(cols, rows);
+    memcpy(b.ts.data(), p, rows * sizeof(int64_t));
+    p += rows * sizeof(int64_t);
+    memcpy(b.data.data(), p, (size_t)rows * cols * sizeof(T));
+    p += (size_t)rows * cols * sizeof(T);
+    memcpy(b.nulls.data(), p, (size_t)rows * cols);
+    p += (size_t)rows * cols;
+    b.count = rows;
+    return p;
+}
+
+static void spoolRows(WriterShard &shard, const Device &d)
+{
+    uint64_t lost = shard.lostBatches + shard.spool.dropped;
+    char *p = NULL;
+    if (shard.spool.base != NULL)
+    {
+        p = spoolReserve(shard.spool, sizeof(SpoolBatch) + spooledSize<float>(d.analogs.count, d.analogs.cols) +
+                                          spooledSize<uint8_t>(d.bools.count, d.bools.cols) +
+                                          spooledSize<uint16_t>(d.bits.count, d.bits.cols) +
+                                          spooledSize<uint16_t>(d.raws.count, d.raws.cols) +
+                                          spooledSize<int32_t>(d.missed.count, d.missed.cols));
+    }
+    if (p == NULL)
+    {
+        ++shard.lostBatches;
+    }
+    else
+    {
+        SpoolBatch hdr = {d.id, d.analogs.count, d.bools.count, d.analogs.cols, d.bools.cols,
+                          d.bits.count, d.bits.cols, d.raws.count, d.raws.cols, d.missed.count};
+        memcpy(p, &hdr, sizeof(hdr));
+        p = spoolColumns(p + sizeof(hdr), d.analogs);
+        p = spoolColumns(p, d.bools);
+        p = spoolColumns(p, d.bits);
+        p = spoolColumns(p, d.raws);
+        spoolColumns(p, d.missed);
+        spoolCommit(shard.spool);
+    }
+
+    uint64_t now = shard.lostBatches + shard.spool.dropped;
+    if (now != lost && (now & (now - 1)) == 0)
+    {
+        printf("Writer %d: %lu batches lost, spool full or disabled\n", shard.id, (unsigned long)now);
+        LOG(WARNING) << "Writer " << shard.id << ": " << now << " batches lost, spool full or disabled";
+    }
+}
+
+// Inserts the oldest spooled batches for up to SPOOL_REPLAY_SLICE_MS. A
+// batch is only popped once all of its inserts succeeded or TDengine refused
+// it; replaying one twice is harmless, rows with the same timestamp
+// overwrite each other.
+static void replaySpool(WriterShard &shard, std::vector<Device> &devices)
+{
+    int64_t until = writerSteadyMs() + SPOOL_REPLAY_SLICE_MS;
+    const char *p;
+    uint32_t len;
+    while ((p = spoolFront(shard.spool, len)) != NULL)
+    {
+        SpoolBatch hdr;
+        memcpy(&hdr, p, sizeof(hdr));
+        const Device *d = NULL;
+        for (const Device &dev : devices)
+        {
+            if (dev.id == hdr.device)
+            {
+                d = &dev;
+                break;
+            }
+        }
+        if (d == NULL || d->analogs.cols != hdr.analogCols || d->bools.cols != hdr.boolCols || d->bits.cols != hdr.bitCols ||
+            d->raws.cols != hdr.rawCols || hdr.analogRows < 0 || hdr.boolRows < 0 || hdr.bitRows < 0 || hdr.rawRows < 0 ||
+            hdr.missedRows < 0 ||
+            len != sizeof(hdr) + spooledSize<float>(hdr.analogRows, hdr.analogCols) +
+                       spooledSize<uint8_t>(hdr.boolRows, hdr.boolCols) + spooledSize<uint16_t>(hdr.bitRows, hdr.bitCols) +
+                       spooledSize<uint16_t>(hdr.rawRows, hdr.rawCols) + spooledSize<int32_t>(hdr.missedRows, 1))
+        {
+            printf("Writer %d: spooled rows of device %d no longer match the config, dropped\n", shard.id, hdr.device);
+            LOG(WARNING) << "Writer " << shard.id << ": spooled rows of device " << hdr.device << " no longer match the config, dropped";
+            spoolPop(shard.spool);
+            continue;
+        }
+
+        p = unspoolColumns(p + sizeof(hdr), shard.replayAnalogs, hdr.analogCols, hdr.analogRows);
+        p = unspoolColumns(p, shard.replayBools, hdr.boolCols, hdr.boolRows);
+        p = unspoolColumns(p, shard.replayBits, hdr.bitCols, hdr.bitRows);
+        p = unspoolColumns(p, shard.replayRaws, hdr.rawCols, hdr.rawRows);
+        unspoolColumns(p, shard.replayMissed, 1, hdr.missedRows);
+
+        bool inserted = insertRows(shard, *d, shard.replayAnalogs, shard.replayRaws, shard.replayBools, shard.replayBits,
+                                   shard.replayMissed, shard.replayAnalogTable, shard.replayRawTable,
+                                   shard.replayBoolTable, shard.replayBitTable, shard.replayMissedTable);
+        if (!inserted && insertUnavailable(shard, *d))
+        {
+            return;
+        }
+        if (inserted)
+        {
+            shard.retryMs = 0;
+        }
+        spoolPop(shard.spool);
+        if (writerSteadyMs() >= until)
+        {
+            return;
+        }
+    }
+    printf("Writer %d: spool replayed\n", shard.id);
+    LOG(INFO) << "Writer " << shard.id << ": spool replayed";
+}
+
+static void reconnectWriter(WriterShard &shard)
+{
+    const TaosLogin &l = shard.login;
+    shard.conn = taosTryConnect(l.ip.c_str(), l.user.c_str(), l.password.c_str(), l.database.c_str(), l.port);
+    if (shard.conn == NULL)
+    {
+        retryLater(shard);
+        return;
+    }
+    printf("Writer %d: TDengine back, %lu spooled bytes to replay\n", shard.id,
+           (unsigned long)(shard.spool.base != NULL ? spoolUsed(shard.spool) : 0));
+    LOG(INFO) << "Writer " << shard.id << ": TDengine back, " << (shard.spool.base != NULL ? spoolUsed(shard.spool) : 0)
+              << " spooled bytes to replay";
+}
+
+// Rows go to TDengine directly only while nothing older waits in the spool,
+// which keeps every device's rows in time order
+static void flushDevice(WriterShard &shard, Device &d)
+{
+    auto start = std::chrono::steady_clock::now();
+    int analogRows = std::max(d.analogs.count, d.raws.count);
+    int boolRows = d.bools.count + d.bits.count;
+    int missedRows = d.missed.count;
+    if (d.pathAllocs > 0)
+    {
+        printf("Device %d: decoding made %lu heap allocations\n", d.id, (unsigned long)d.pathAllocs);
+        LOG(WARNING) << "Device " << d.id << ": decoding made " << d.pathAllocs << " heap allocations";
+        d.pathAllocs = 0;
+    }
+    bool inserted = false;
+    bool rejected = false;
+    if (shard.conn != NULL && !spoolPending(shard))
+    {
+        inserted = insertRows(shard, d, d.analogs, d.raws, d.bools, d.bits, d.missed, d.analogTable, d.rawTable,
+                              d.boolTable, d.bitTable, d.missedTable);
+        if (inserted)
+        {
+            shard.retryMs = 0;
+        }
+        else
+        {
+            rejected = !insertUnavailable(shard, d);
+        }
+    }
+    if (!inserted && !rejected)
+    {
+        spoolRows(shard, d);
+    }
+    d.analogs.clear();
+    d.raws.clear();
+    d.bools.clear();
+    d.bits.clear();
+    d.missed.clear();
+
+    auto end = std::chrono::steady_clock::now();
+    auto elapsed_time = std::chrono::duration_cast<std::chrono::microseconds>(end - start);
+    shard.busyMicros += elapsed_time.count();
+    printf("Device %d %s %d analog, %d bool and %d missed rows in %ld microseconds\n", d.id,
+           inserted ? "inserted" : rejected ? "dropped" : "spooled",
+           analogRows, boolRows, missedRows, elapsed_time.count());
+}
+
+// Engine side: queue a copy of the frame on the device's ring and wake its
+// writer. Never blocks; when the writer is behind the frame is dropped.
+static inline bool readChanged(uint64_t changedReads, size_t read)
+{
+    return (changedReads >> std::min(read, (size_t)63)) & 1;
+}
+
+// Copies only the registers of reads that changed since the last queued
+// frame, and none when the PLC scan has not moved on; changes and polled
+// groups of frames the ring had no room for carry over to the next one.
+void queueFrame(WriterShard &shard, Device &d, const uint16_t *frame, int64_t millis, uint64_t changedReads,
+                uint64_t polledGroups)
+{
+    d.dirtyReads |= changedReads;
+    d.dirtyGroups |= polledGroups;
+    uint16_t *slot = d.frames->claim();
+    if (slot == NULL)
+    {
+        uint64_t dropped = d.frames->dropped.load(std::memory_order_relaxed);
+        if ((dropped & (dropped - 1)) == 0)
+        {
+            printf("Device %d: writer behind, %lu frames dropped\n", d.id, (unsigned long)dropped);
+            LOG(WARNING) << "Device " << d.id << ": writer behind, " << dropped << " frames dropped";
+        }
+        return;
+    }
+    if ((d.dirtyReads & d.allReads) == d.allReads)
+    {
+        memcpy(slot, frame, d.plan.frameWords * sizeof(uint16_t));
+    }
+    else if (d.dirtyReads != 0)
+    {
+        for (size_t r = 0; r < d.readSpans.size(); ++r)
+        {
+            const ReadRequest &span = d.readSpans[r];
+            if (readChanged(d.dirtyReads, r) && span.nb > 0)
+            {
+                memcpy(slot + span.addr, frame + span.addr, span.nb * sizeof(uint16_t));
+            }
+        }
+    }
+    d.frames->publish(millis, d.dirtyReads & d.allReads, d.dirtyGroups);
+    d.dirtyReads = 0;
+    d.dirtyGroups = 0;
+    sem_post(&shard.ready);
+}
+
+// Engine side: queue a marker for a poll that produced no frame. Changes of
+// earlier dropped frames stay pending for the next frame.
+void queueMissed(WriterShard &shard, Device &d, int64_t millis, int err)
+{
+    if (!d.frames->publishMissed(millis, err))
+    {
+        return;
+    }
+    sem_post(&shard.ready);
+}
+
+// false if no frame was published within `ms`
+static bool waitFrames(WriterShard &shard, int64_t ms)
+{
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += ms / 1000;
+    deadline.tv_nsec += (ms % 1000) * 1000000;
+    if (deadline.tv_nsec >= 1000000000)
+    {
+        deadline.tv_sec += 1;
+        deadline.tv_nsec -= 1000000000;
+    }
+    while (sem_timedwait(&shard.ready, &deadline) != 0)
+    {
+        if (errno != EINTR)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static inline void decodeBools(Device &d, const DecodePlan &plan, const uint16_t *frame)
+{
+    if (d.boolStorage == BOOL_PACKED)
+    {
+        packBool(plan, frame, d.bits.stage());
+    }
+    else
+    {
+        decodeBool(plan, frame, d.bools.stage());
+    }
+}
+
+// Decodes every queued frame of `d` straight into its row batches, which
+// keeps the per-frame path off the heap; only the inserts allocate. The
+// staging rows still hold the previous frame, so only reads that changed
+// are decoded again, and a batch none of them touched is committed as
+// unchanged. A missed poll only adds a row to the missed batch; the values
+// rows carry on from the last frame.
+static void drainFrames(WriterShard &shard, Device &d)
+{
+    const uint16_t *frame;
+    int64_t millis;
+    uint64_t changedReads;
+    uint64_t polled;
+    int32_t error;
+    static LatencyHistogram &decodeLatency = metricHistogram("frame_decode");
+    while ((frame = d.frames->front(millis, changedReads, polled, error)) != NULL)
+    {
+        if (d.analogs.count == d.analogs.capacity || d.raws.count == d.raws.capacity ||
+            d.bools.count == d.bools.capacity || d.bits.count == d.bits.capacity || d.missed.count == d.missed.capacity)
+        {
+            flushDevice(shard, d);
+        }
+        if (error != 0)
+        {
+            d.missed.stage()[0] = error;
+            d.missed.commit(millis);
+            d.frames->pop();
+            continue;
+        }
+        MetricTimer timed(decodeLatency);
+        uint64_t mark = threadAllocations();
+        bool analogChanged = false;
+        bool rawChanged = false;
+        bool boolChanged = false;
+        if (changedReads == d.allReads)
+        {
+            decodeAnalog(d.decode, frame, d.analogs.stage());
+            decodeRaw(d.rawPlan, frame, d.raws.stage());
+            decodeBools(d, d.decode, frame);
+            analogChanged = rawChanged = boolChanged = true;
+        }
+        else if (changedReads != 0)
+        {
+            for (size_t r = 0; r < d.readPlans.size(); ++r)
+            {
+                const DecodePlan &p = d.readPlans[r];
+                if (!readChanged(changedReads, r))
+                {
+                    continue;
+                }
+                if (!p.op16.empty() || !p.op32.empty())
+                {
+                    decodeAnalog(p, frame, d.analogs.stage());
+                    analogChanged = true;
+                }
+                if (!p.bools.empty())
+                {
+                    decodeBools(d, p, frame);
+                    boolChanged = true;
+                }
+                if (r < d.rawReadPlans.size() && !d.rawReadPlans[r].op16.empty())
+                {
+                    decodeRaw(d.rawReadPlans[r], frame, d.raws.stage());
+                    rawChanged = true;
+                }
+            }
+        }
+        d.frames->pop();
+        if (analogChanged)
+        {
+            commitChanged(d.analogs, d.analogFilter, millis, polled);
+        }
+        else
+        {
+            commitUnchanged(d.analogs, d.analogFilter, millis, d.unchangedHeartbeatMs, polled);
+        }
+        if (rawChanged)
+        {
+            commitChanged(d.raws, d.rawFilter, millis, polled);
+        }
+        else
+        {
+            commitUnchanged(d.raws, d.rawFilter, millis, d.unchangedHeartbeatMs, polled);
+        }
+        if (boolChanged)
+        {
+            commitChanged(d.bools, d.boolFilter, millis, polled);
+            commitChanged(d.bits, d.bitFilter, millis, polled);
+        }
+        else
+        {
+            commitUnchanged(d.bools, d.boolFilter, millis, d.unchangedHeartbeatMs, polled);
+            commitUnchanged(d.bits, d.bitFilter, millis, d.unchangedHeartbeatMs, polled);
+        }
+        d.pathAllocs += threadAllocations() - mark;
+    }
+}
+
+// Waits no longer than the oldest buffered row has left before max age, so
+// quiet devices are flushed too. However long an insert takes, the engine
+// keeps polling; frames wait in the rings meanwhile.
+void runWriter(WriterShard &shard, std::vector<Device> &devices)
+{
+    shard.rows = shard.policy.minRows;
+    shard.windowStart = writerSteadyMs();
+    shard.busyMicros = 0;
+    while (1)
+    {
+        if (shard.conn == NULL && writerSteadyMs() >= shard.retryAt)
+        {
+            reconnectWriter(shard);
+        }
+        if (shard.conn != NULL && spoolPending(shard))
+        {
+            replaySpool(shard, devices);
+        }
+
+        int64_t now = writerWallMs();
+        int64_t wait = shard.policy.maxAgeMs;
+        if (shard.conn == NULL)
+        {
+            wait = std::min(wait, shard.retryAt - writerSteadyMs());
+        }
+        else if (spoolPending(shard))
+        {
+            wait = 0;
+        }
+        for (int i : shard.devices)
+        {
+            const Device &d = devices[i];
+            if (d.analogs.count > 0 || d.raws.count > 0 || d.bools.count > 0 || d.bits.count > 0 || d.missed.count > 0)
+            {
+                wait = std::min(wait, oldestRow(d) + shard.policy.maxAgeMs - now);
+            }
+        }
+
+        if (waitFrames(shard, std::max<int64_t>(wait, 0)))
+        {
+            for (int i : shard.devices)
+            {
+                drainFrames(shard, devices[i]);
+            }
+        }
+
+        now = writerWallMs();
+        for (int i : shard.devices)
+        {
+            if (flushDue(shard, devices[i], now))
+            {
+                flushDevice(shard, devices[i]);
+            }
+        }
+        adaptFlush(shard, writerSteadyMs());
+    }
+}
+
+// Queue depth (frames waiting now and the most since the last report),
+// frames dropped because the writer fell behind and frames that repeated
+// the previous PLC scan
+void reportWriters(const std::vector<std::unique_ptr<WriterShard>> &writers, std::vector<Device> &devices)
+{
+    for (size_t w = 0; w < writers.size(); ++w)
+    {
+        uint32_t depth = 0;
+        uint32_t highWater = 0;
+        uint32_t slots = 0;
+        uint64_t dropped = 0;
+        uint64_t published = 0;
+        uint64_t unchanged = 0;
+        for (int i : writers[w]->devices)
+        {
+            FrameRing &r = *devices[i].frames;
+            depth += r.depth();
+            highWater = std::max(highWater, r.highWater.exchange(0, std::memory_order_relaxed));
+            slots = r.slots;
+            dropped += r.dropped.load(std::memory_order_relaxed);
+            published += r.published.load(std::memory_order_relaxed);
+            unchanged += r.unchanged.load(std::memory_order_relaxed);
+        }
+        printf("Writer %zu: %u frames queued, at most %u of %u per device, %lu frames dropped, %lu of %lu unchanged\n",
+               w, depth, highWater, slots, (unsigned long)dropped, (unsigned long)unchanged, (unsigned long)published);
+        LOG(INFO) << "Writer " << w << ": " << depth << " frames queued, at most " << highWater << " of " << slots
+                  << " per device, " << dropped << " frames dropped, " << unchanged << " of " << published << " unchanged";
+    }
 }
 
 #endif // DATA_ACQUISITION_SAVE_H
\ No newline at end of file
@@ -0,0 +1,312 @@
+#include <algorithm>
+#include <map>
+#include <math.h>
+#include <set>
+#include <time.h>
+#include "device.h"
+#include "modbus_pipeline.h"
+
+static void deviceError(const std::string &msg)
+{
+    printf("Device config error: %s\n", msg.c_str());
+    LOG(ERROR) << "Device config error: " << msg;
+    exit(EXIT_FAILURE);
+}
+
+// Moves the UINT16/INT16 columns of `map` to `raw`, both renumbered from 0,
+// and records their s_analog names; bands go to register units
+static void splitRawColumns(Device &dev, RegisterMap &map, RegisterMap &raw)
+{
+    std::vector<RegisterEntry> floats;
+    for (RegisterEntry e : map.analogs)
+    {
+        std::string name = "c" + std::to_string(e.col);
+        if (e.words == 1)
+        {
+            e.col = (int)raw.analogs.size();
+            if (e.scale != 0)
+            {
+                e.band.abs /= fabsf(e.scale);
+            }
+            e.band.rawSigned = e.type == REG_INT16;
+            raw.analogs.push_back(e);
+            dev.rawNames.push_back(name);
+            dev.rawTypes.push_back(e.type == REG_INT16 ? TSDB_DATA_TYPE_SMALLINT : TSDB_DATA_TYPE_USMALLINT);
+        }
+        else
+        {
+            e.col = (int)floats.size();
+            floats.push_back(e);
+            dev.analogNames.push_back(name);
+        }
+    }
+    map.analogs = floats;
+}
+
+// Sorts the map's period_ms values into poll groups, fastest first, and
+// tags every entry's band with its group; entries without one are polled
+// every `pollPeriodMs`. Returns the period of each group.
+static std::vector<int> pollGroups(Device &dev, RegisterMap &map, int pollPeriodMs, int index)
+{
+    std::vector<int> periods;
+    for (std::vector<RegisterEntry> *entries : {&map.analogs, &map.bools})
+    {
+        for (RegisterEntry &e : *entries)
+        {
+            if (e.periodMs == 0)
+            {
+                e.periodMs = pollPeriodMs;
+            }
+            if (e.periodMs % pollPeriodMs != 0)
+            {
+                deviceError("device " + std::to_string(index) + ": period_ms " + std::to_string(e.periodMs) +
+                            " of register " + std::to_string(e.addr) + " is no multiple of poll_period_ms");
+            }
+            if (std::find(periods.begin(), periods.end(), e.periodMs) == periods.end())
+            {
+                periods.push_back(e.periodMs);
+            }
+        }
+    }
+    std::sort(periods.begin(), periods.end());
+    if (periods.size() > 64)
+    {
+        deviceError("device " + std::to_string(index) + ": more than 64 different period_ms");
+    }
+    for (std::vector<RegisterEntry> *entries : {&map.analogs, &map.bools})
+    {
+        for (RegisterEntry &e : *entries)
+        {
+            e.band.group = (uint8_t)(std::find(periods.begin(), periods.end(), e.periodMs) - periods.begin());
+        }
+    }
+    for (int period : periods)
+    {
+        dev.groupEvery.push_back(period / pollPeriodMs);
+    }
+    return periods;
+}
+
+static RegisterMap periodEntries(const RegisterMap &map, int periodMs)
+{
+    RegisterMap part;
+    for (const RegisterEntry &e : map.analogs)
+    {
+        if (e.periodMs == periodMs)
+        {
+            part.analogs.push_back(e);
+        }
+    }
+    for (const RegisterEntry &e : map.bools)
+    {
+        if (e.periodMs == periodMs)
+        {
+            part.bools.push_back(e);
+        }
+    }
+    return part;
+}
+
+static Device parseDevice(const json &d, const json &defaults, int index, bool legacy, int pollPeriodMs)
+{
+    Device dev;
+    try
+    {
+        dev.id = d.value("id", index + 1);
+        dev.ip = d.at(legacy ? "modbus_ip" : "ip").get<std::string>();
+        dev.port = d.at(legacy ? "modbus_port" : "port").get<int>();
+        dev.slave = d.at(legacy ? "modbus_id" : "slave").get<int>();
+        // A standby_port alone opens the standby to the same PLC
+        dev.standbyPort = d.value("standby_port", dev.port);
+        dev.standbyIp = d.value("standby_ip", d.contains("standby_port") ? dev.ip : std::string());
+        dev.registerMap = d.value("register_map", defaults.value("register_map", std::string(DEFAULT_REGISTER_MAP)));
+        // Older configs keep their analogYYYYMMDD subtables
+        dev.table = legacy ? std::string() : d.value("table", "d" + std::to_string(dev.id) + "_");
+        dev.stable = legacy ? std::string() : d.value("stable", std::string());
+        std::string storage = d.value("bool_storage", defaults.value("bool_storage", std::string("columns")));
+        if (storage != "columns" && storage != "packed")
+        {
+            deviceError("device " + std::to_string(index) + ": bool_storage must be \"columns\" or \"packed\"");
+        }
+        dev.boolStorage = storage == "packed" ? BOOL_PACKED : BOOL_COLUMNS;
+        storage = d.value("analog_storage", defaults.value("analog_storage", std::string("float")));
+        if (storage != "float" && storage != "raw")
+        {
+            deviceError("device " + std::to_string(index) + ": analog_storage must be \"float\" or \"raw\"");
+        }
+        dev.analogStorage = storage == "raw" ? ANALOG_RAW : ANALOG_FLOAT;
+        dev.window = d.value("modbus_window", defaults.value("modbus_window", DEFAULT_MODBUS_WINDOW));
+        int gap = d.value("read_gap", defaults.value("read_gap", DEFAULT_READ_GAP));
+        if (gap < 0)
+        {
+            deviceError("device " + std::to_string(index) + ": read_gap must not be negative");
+        }
+        dev.unchangedHeartbeatMs = 1000 * d.value("unchanged_heartbeat_s", defaults.value("unchanged_heartbeat_s", 0));
+        RegisterMap map = loadRegisterMap(dev.registerMap.c_str());
+        std::vector<int> periods = pollGroups(dev, map, pollPeriodMs, index);
+        dev.plan = compileDecodePlan(map);
+        RegisterMap decodeMap = map;
+        RegisterMap rawMap;
+        if (dev.analogStorage == ANALOG_RAW)
+        {
+            splitRawColumns(dev, decodeMap, rawMap);
+        }
+        dev.decode = dev.analogStorage == ANALOG_RAW ? compileDecodePlan(decodeMap) : dev.plan;
+        dev.rawPlan = compileDecodePlan(rawMap);
+        // Each group is read on its own, so a slow group never rides along
+        // with a fast one in the same request
+        for (size_t g = 0; g < periods.size(); ++g)
+        {
+            RegisterMap group = periodEntries(map, periods[g]);
+            RegisterMap decodeGroup = periodEntries(decodeMap, periods[g]);
+            RegisterMap rawGroup = periodEntries(rawMap, periods[g]);
+            for (ReadRequest r : planReads(compileRangePlan(group, dev.plan, 0, dev.plan.frameWords), gap))
+            {
+                r.group = (int)g;
+                dev.reads.push_back(r);
+                DecodePlan all = compileRangePlan(group, dev.plan, r.addr, r.nb);
+                dev.readSpans.push_back({all.minAddr, all.maxAddr - all.minAddr + 1, (int)g});
+                if (dev.analogStorage == ANALOG_RAW)
+                {
+                    dev.readPlans.push_back(compileRangePlan(decodeGroup, dev.decode, r.addr, r.nb));
+                    dev.rawReadPlans.push_back(compileRangePlan(rawGroup, dev.rawPlan, r.addr, r.nb));
+                }
+                else
+                {
+                    dev.readPlans.push_back(all);
+                }
+            }
+        }
+        dev.allReads = dev.reads.size() >= 64 ? ~0ull : (1ull << dev.reads.size()) - 1;
+        dev.dirtyReads = ~0ull;
+        dev.dirtyGroups = 0;
+    }
+    catch (const json::exception &e)
+    {
+        deviceError("device " + std::to_string(index) + ": " + e.what());
+    }
+    return dev;
+}
+
+// Devices of one `stable` insert into the same supertables, so they must
+// bind the same columns of the same types
+static bool sameColumns(const Device &a, const Device &b)
+{
+    return a.analogStorage == b.analogStorage && a.boolStorage == b.boolStorage &&
+           a.plan.analogCols == b.plan.analogCols && a.plan.boolCols == b.plan.boolCols &&
+           a.analogNames == b.analogNames && a.rawNames == b.rawNames && a.rawTypes == b.rawTypes;
+}
+
+std::vector<Device> loadDevices(const json &config_data, int writers, int frameSlots, int batchRows, int pollPeriodMs)
+{
+    std::vector<Device> devices;
+    if (config_data.contains("devices"))
+    {
+        const json &list = config_data["devices"];
+        for (size_t i = 0; i < list.size(); ++i)
+        {
+            devices.push_back(parseDevice(list[i], config_data, (int)i, false, pollPeriodMs));
+        }
+    }
+    else
+    {
+        devices.push_back(parseDevice(config_data, config_data, 0, true, pollPeriodMs));
+    }
+    if (devices.empty())
+    {
+        deviceError("no devices");
+    }
+
+    std::set<int> ids;
+    std::set<std::string> tables;
+    std::map<std::string, const Device *> schemas;
+    for (size_t i = 0; i < devices.size(); ++i)
+    {
+        Device &dev = devices[i];
+        if (!ids.insert(dev.id).second)
+        {
+            deviceError("duplicate id " + std::to_string(dev.id));
+        }
+        if (!tables.insert(dev.table).second)
+        {
+            deviceError("device " + std::to_string(dev.id) + " reuses table prefix '" + dev.table + "'");
+        }
+        auto schema = schemas.emplace(dev.stable, &dev).first->second;
+        if (!sameColumns(*schema, dev))
+        {
+            deviceError("devices " + std::to_string(schema->id) + " and " + std::to_string(dev.id) +
+                        " share supertables s_*" + dev.stable + " but differ in storage or columns");
+        }
+        dev.shard = (int)(i % writers);
+        dev.frames.reset(new FrameRing(dev.plan.frameWords, frameSlots));
+        dev.analogs.init(dev.decode.analogCols, batchRows);
+        dev.analogFilter.init(dev.decode.analogBands);
+        dev.raws.init(dev.rawPlan.analogCols, batchRows);
+        dev.rawFilter.init(dev.rawPlan.analogBands);
+        // A BOOL16 entry's band covers its 16 bits, i.e. exactly one word
+        std::vector<Deadband> wordBands;
+        for (int c = 0; c < dev.plan.boolCols; c += 16)
+        {
+            wordBands.push_back(dev.plan.boolBands[c]);
+        }
+        bool packed = dev.boolStorage == BOOL_PACKED;
+        dev.bools.init(packed ? 0 : dev.plan.boolCols, batchRows);
+        dev.boolFilter.init(packed ? std::vector<Deadband>() : dev.plan.boolBands);
+        dev.bits.init(packed ? (int)wordBands.size() : 0, batchRows);
+        dev.bitFilter.init(packed ? wordBands : std::vector<Deadband>());
+        dev.missed.init(1, batchRows);
+        dev.pathAllocs = 0;
+    }
+    return devices;
+}
+
+const char *subtableName(SubtableName &cache, const std::string &table, const char *kind, int64_t millis)
+{
+    if (millis >= cache.from && millis < cache.to)
+    {
+        return cache.name;
+    }
+    time_t t = millis / 1000;
+    struct tm day;
+    localtime_r(&t, &day);
+    char date[16];
+    strftime(date, sizeof(date), "%Y%m%d", &day);
+    snprintf(cache.name, sizeof(cache.name), "%s%s%s", table.c_str(), kind, date);
+
+    // mktime normalises day + 1 and picks the right DST offset for each midnight
+    day.tm_hour = 0;
+    day.tm_min = 0;
+    day.tm_sec = 0;
+    day.tm_isdst = -1;
+    cache.from = (int64_t)mktime(&day) * 1000;
+    day.tm_mday += 1;
+    day.tm_isdst = -1;
+    cache.to = (int64_t)mktime(&day) * 1000;
+    return cache.name;
+}
+
+void printDevices(const std::vector<Device> &devices)
+{
+    for (const Device &dev : devices)
+    {
+        const char *boolKind = dev.boolStorage == BOOL_PACKED ? "bits" : "bool";
+        printf("Device %d: %s:%d slave %d, map %s (%d analog, %d of them raw, %d bool), %zu reads, window %d, writer %d, tables %sanalog/%s%s -> s_analog%s/s_%s%s\n",
+               dev.id, dev.ip.c_str(), dev.port, dev.slave, dev.registerMap.c_str(), dev.plan.analogCols, dev.rawPlan.analogCols, dev.plan.boolCols,
+               dev.reads.size(), dev.window, dev.shard, dev.table.c_str(), dev.table.c_str(), boolKind, dev.stable.c_str(),
+               boolKind, dev.stable.c_str());
+        LOG(INFO) << "Device " << dev.id << ": " << dev.ip << ":" << dev.port << " slave " << dev.slave << ", map " << dev.registerMap
+                  << " (" << dev.plan.analogCols << " analog, " << dev.plan.boolCols << " bool), " << dev.reads.size()
+                  << " reads, window " << dev.window << ", writer " << dev.shard;
+        if (!dev.standbyIp.empty())
+        {
+            printf("  standby connection %s:%d\n", dev.standbyIp.c_str(), dev.standbyPort);
+            LOG(INFO) << "  standby connection " << dev.standbyIp << ":" << dev.standbyPort;
+        }
+        for (size_t g = 0; g < dev.groupEvery.size() && dev.groupEvery.size() > 1; ++g)
+        {
+            int reads = (int)std::count_if(dev.reads.begin(), dev.reads.end(), [g](const ReadRequest &r) { return r.group == (int)g; });
+            printf("  poll group %zu: %d reads every %d polls\n", g, reads, dev.groupEvery[g]);
+            LOG(INFO) << "  poll group " << g << ": " << reads << " reads every " << dev.groupEvery[g] << " polls";
+        }
+    }
+}
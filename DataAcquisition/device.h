@@ -0,0 +1,107 @@
+#ifndef DEVICE_H
+#define DEVICE_H
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "gVal.h"
+#include "modbus_read.h"
+#include "frame_ring.h"
+#include "change_filter.h"
+
+#define DEFAULT_TAOS_WRITERS 1
+// Frames queued between the engine and the writer per device; covers a
+// writer stalled in an insert for this many poll periods
+#define DEVICE_FRAME_SLOTS 64
+
+// How analog columns are stored: all FLOAT in s_analog<stable>, or UINT16 and
+// INT16 registers unscaled as SMALLINT (UNSIGNED) columns of the same name in
+// s_raw<stable>, with their scales in the s_scale catalog (see createStable)
+enum AnalogStorage
+{
+    ANALOG_FLOAT,
+    ANALOG_RAW
+};
+
+// How bool columns are stored: one BOOL column each in s_bool<stable>, or 16
+// to a USMALLINT word column in s_bits<stable> (see packBool)
+enum BoolStorage
+{
+    BOOL_COLUMNS,
+    BOOL_PACKED
+};
+
+// Daily subtable name, recomputed only when a row falls outside [from, to)
+struct SubtableName
+{
+    int64_t from = 0; // ms, local midnight
+    int64_t to = 0;
+    char name[100];
+};
+
+// One PLC: where it is, how its registers decode and where its rows go.
+// The row batches belong to writer `shard` and are only touched there; all
+// buffers are sized from the register map when the device is loaded.
+struct Device
+{
+    int id;             // dev TAG
+    std::string ip;
+    int port;
+    std::string standbyIp; // "" for no standby connection
+    int standbyPort;
+    int slave;
+    std::string registerMap;
+    std::string table;  // subtables are <table>analog<yyyymmdd>, <table>bool<yyyymmdd>
+    std::string stable; // supertables are s_analog<stable>, s_raw<stable>, s_bool<stable> or s_bits<stable>
+    AnalogStorage analogStorage;
+    BoolStorage boolStorage;
+    int window;
+    DecodePlan plan;                   // every register the device reads
+    DecodePlan decode;                 // into analogs and bools: plan, less the raw columns
+    DecodePlan rawPlan;                // into raws, empty unless raw
+    std::vector<std::string> analogNames; // s_analog columns of analogs when raw
+    std::vector<std::string> rawNames;    // s_raw columns of raws
+    std::vector<int> rawTypes;            // per raw column, TSDB_DATA_TYPE_(U)SMALLINT
+    std::vector<ReadRequest> reads;       // grouped by poll group, fastest first
+    std::vector<int> groupEvery;          // per poll group, polled every this many polls
+    std::vector<ReadRequest> readSpans;   // per read, the frame words its entries decode from
+    std::vector<DecodePlan> readPlans;    // per read, decode limited to its entries
+    std::vector<DecodePlan> rawReadPlans; // same for rawPlan
+    uint64_t allReads;                 // frame mask with every read changed
+    uint64_t dirtyReads;               // engine side: changes not yet queued
+    uint64_t dirtyGroups;              // engine side: groups polled since the last queued frame
+    int32_t unchangedHeartbeatMs;      // 0 stores every unchanged frame
+    int shard;
+    std::unique_ptr<FrameRing> frames;
+    ColumnBatch<float> analogs;
+    ColumnBatch<uint16_t> raws; // no columns unless raw
+    ColumnBatch<uint8_t> bools; // no columns when packed
+    ColumnBatch<uint16_t> bits; // no columns unless packed
+    ColumnBatch<int32_t> missed; // err of polls that produced no frame
+    ChangeFilter<float> analogFilter;
+    ChangeFilter<uint16_t> rawFilter;
+    ChangeFilter<uint8_t> boolFilter;
+    ChangeFilter<uint16_t> bitFilter;
+    SubtableName analogTable;
+    SubtableName rawTable;
+    SubtableName boolTable;
+    SubtableName bitTable;
+    SubtableName missedTable;
+    uint64_t pathAllocs; // heap allocations decoding since the last insert
+};
+
+// Reads the "devices" array of config.json, or the single modbus_ip/
+// modbus_port/modbus_id device older configs describe, each with an optional
+// standby_ip and standby_port. Top-level register_map, read_gap,
+// modbus_window, unchanged_heartbeat_s, analog_storage and bool_storage are
+// the defaults for every device. Frame rings hold `frameSlots` frames and row
+// batches up to `batchRows` rows. Register map period_ms values must be
+// multiples of `pollPeriodMs`.
+std::vector<Device> loadDevices(const json &config_data, int writers, int frameSlots, int batchRows, int pollPeriodMs);
+
+// <table><kind><yyyymmdd> for the local day holding `millis`
+const char *subtableName(SubtableName &cache, const std::string &table, const char *kind, int64_t millis);
+
+void printDevices(const std::vector<Device> &devices);
+
+#endif // DEVICE_H
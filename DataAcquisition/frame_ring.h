@@ -0,0 +1,175 @@
+#ifndef FRAME_RING_H
+#define FRAME_RING_H
+
+#include <stdint.h>
+#include <atomic>
+#include <vector>
+
+// Rows kept column-major (one contiguous array per column plus one of
+// timestamps) so a batch binds with one TAOS_MULTI_BIND per column. A frame
+// is decoded into the staging row and scattered into the columns by commit,
+// or by commitChanged, which also marks unchanged values NULL.
+template <typename T>
+struct ColumnBatch
+{
+    std::vector<T> data; // column c, row r at c * capacity + r
+    std::vector<char> nulls; // same layout, 1 = NULL
+    std::vector<int64_t> ts;
+    std::vector<T> row;
+    int cols = 0;
+    int capacity = 0;
+    int count = 0;
+
+    void init(int batchCols, int rows)
+    {
+        cols = batchCols;
+        capacity = rows;
+        count = 0;
+        data.assign((size_t)batchCols * rows, T());
+        nulls.assign((size_t)batchCols * rows, 0);
+        ts.assign(rows, 0);
+        row.assign(batchCols, T());
+    }
+
+    T *column(int c)
+    {
+        return &data[(size_t)c * capacity];
+    }
+
+    T *stage()
+    {
+        return row.data();
+    }
+
+    // false when full
+    bool commit(int64_t millis)
+    {
+        if (count == capacity)
+        {
+            return false;
+        }
+        T *dst = data.data() + count;
+        char *isNull = nulls.data() + count;
+        for (int c = 0; c < cols; ++c)
+        {
+            dst[(size_t)c * capacity] = row[c];
+            isNull[(size_t)c * capacity] = 0;
+        }
+        ts[count++] = millis;
+        return true;
+    }
+
+    void clear()
+    {
+        count = 0;
+    }
+};
+
+// Bounded lock-free queue of frames from the engine thread polling a device
+// (the only producer) to the writer owning it (the only consumer). Frames are
+// copied into a slot in place and published with their timestamp, a mask
+// of the reads that changed and one of the poll groups read; only the changed
+// parts of the slot are meant to be read. A poll that produced no frame is
+// queued as a marker carrying its error instead, in order with the frames.
+// Neither side ever waits for the other, and a full ring drops the new
+// frame.
+struct FrameRing
+{
+    std::vector<uint16_t> data;
+    std::vector<int64_t> millis;
+    std::vector<uint64_t> changed;
+    std::vector<uint64_t> groups;
+    std::vector<int32_t> errors; // 0 for a frame
+    int words;
+    uint32_t slots;
+    alignas(64) std::atomic<uint32_t> tail{0}; // producer
+    alignas(64) std::atomic<uint32_t> head{0}; // consumer
+    std::atomic<uint64_t> dropped{0};
+    std::atomic<uint32_t> highWater{0};
+    std::atomic<uint64_t> published{0};
+    std::atomic<uint64_t> unchanged{0}; // published with an empty mask
+
+    FrameRing(int frameWords, int nSlots)
+        : data((size_t)frameWords * nSlots), millis(nSlots), changed(nSlots), groups(nSlots), errors(nSlots), words(frameWords), slots(nSlots)
+    {
+    }
+
+    // Producer side; NULL when every slot is still queued
+    uint16_t *claim()
+    {
+        uint32_t t = tail.load(std::memory_order_relaxed);
+        if (t - head.load(std::memory_order_acquire) == slots)
+        {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return NULL;
+        }
+        return &data[(size_t)(t % slots) * words];
+    }
+
+    // Producer side, once the claimed slot is filled
+    void publish(int64_t ms, uint64_t changedReads, uint64_t polledGroups)
+    {
+        uint32_t t = tail.load(std::memory_order_relaxed);
+        millis[t % slots] = ms;
+        changed[t % slots] = changedReads;
+        groups[t % slots] = polledGroups;
+        errors[t % slots] = 0;
+        tail.store(t + 1, std::memory_order_release);
+        uint32_t depth = t + 1 - head.load(std::memory_order_relaxed);
+        if (depth > highWater.load(std::memory_order_relaxed))
+        {
+            highWater.store(depth, std::memory_order_relaxed);
+        }
+        published.fetch_add(1, std::memory_order_relaxed);
+        if (changedReads == 0)
+        {
+            unchanged.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    // Producer side, without a claim: queues a missed poll marker; false when
+    // the ring is full
+    bool publishMissed(int64_t ms, int32_t error)
+    {
+        if (claim() == NULL)
+        {
+            return false;
+        }
+        uint32_t t = tail.load(std::memory_order_relaxed);
+        millis[t % slots] = ms;
+        changed[t % slots] = 0;
+        groups[t % slots] = 0;
+        errors[t % slots] = error;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side; the oldest frame, NULL when empty. A non-zero `error`
+    // makes it a missed poll marker, whose frame must not be read.
+    const uint16_t *front(int64_t &ms, uint64_t &changedReads, uint64_t &polledGroups, int32_t &error)
+    {
+        uint32_t h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire))
+        {
+            return NULL;
+        }
+        ms = millis[h % slots];
+        changedReads = changed[h % slots];
+        polledGroups = groups[h % slots];
+        error = errors[h % slots];
+        return &data[(size_t)(h % slots) * words];
+    }
+
+    // Consumer side, once the front frame is decoded
+    void pop()
+    {
+        head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    uint32_t depth() const
+    {
+        return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+    }
+};
+
+#endif // FRAME_RING_H
@@ -0,0 +1,199 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "latest_frame.h"
+
+// Sections start on their own cache line
+static uint32_t alignUp(uint32_t n)
+{
+    return (n + 63) & ~63u;
+}
+
+static int mapSegment(LatestFrame *f, int fd, size_t bytes, int prot)
+{
+    void *p = mmap(NULL, bytes, prot, fd == -1 ? MAP_SHARED | MAP_ANONYMOUS : MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED)
+    {
+        return -1;
+    }
+    f->fd = fd;
+    f->bytes = bytes;
+    f->header = (LatestFrameHeader *)p;
+    return 0;
+}
+
+static void initSegment(LatestFrame *f, int device, int analogCols, int boolCols, uint32_t analogOffset,
+                        uint32_t boolOffset, uint32_t bytes)
+{
+    LatestFrameHeader *h = f->header;
+    h->version = LATEST_FRAME_VERSION;
+    h->device = device;
+    h->analogCols = analogCols;
+    h->boolCols = boolCols;
+    h->analogOffset = analogOffset;
+    h->boolOffset = boolOffset;
+    h->bytes = bytes;
+    h->seq = 0;
+    h->millis = 0;
+    h->frames = 0;
+    __atomic_store_n(&h->magic, LATEST_FRAME_MAGIC, __ATOMIC_RELEASE);
+    f->analogs = (float *)((char *)h + analogOffset);
+    f->bools = (uint8_t *)h + boolOffset;
+}
+
+int latestCreate(LatestFrame *f, const char *name, int device, int analogCols, int boolCols)
+{
+    uint32_t analogOffset = alignUp(sizeof(LatestFrameHeader));
+    uint32_t boolOffset = alignUp(analogOffset + analogCols * sizeof(float));
+    uint32_t bytes = alignUp(boolOffset + boolCols);
+
+    if (name == NULL)
+    {
+        if (mapSegment(f, -1, bytes, PROT_READ | PROT_WRITE) != 0)
+        {
+            return -1;
+        }
+        initSegment(f, device, analogCols, boolCols, analogOffset, boolOffset, bytes);
+        return 0;
+    }
+
+    // Readers still mapping the old segment see it as replaced
+    shm_unlink(name);
+    int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd == -1)
+    {
+        return -1;
+    }
+    if (ftruncate(fd, bytes) != 0 || mapSegment(f, fd, bytes, PROT_READ | PROT_WRITE) != 0)
+    {
+        int err = errno;
+        close(fd);
+        shm_unlink(name);
+        errno = err;
+        return -1;
+    }
+    initSegment(f, device, analogCols, boolCols, analogOffset, boolOffset, bytes);
+    return 0;
+}
+
+void latestBeginWrite(LatestFrame *f)
+{
+    uint64_t seq = __atomic_load_n(&f->header->seq, __ATOMIC_RELAXED);
+    __atomic_store_n(&f->header->seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+void latestEndWrite(LatestFrame *f, int64_t millis)
+{
+    f->header->millis = millis;
+    f->header->frames++;
+    uint64_t seq = __atomic_load_n(&f->header->seq, __ATOMIC_RELAXED);
+    __atomic_store_n(&f->header->seq, seq + 1, __ATOMIC_RELEASE);
+}
+
+int latestOpen(LatestFrame *f, const char *name)
+{
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd == -1)
+    {
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || mapSegment(f, fd, st.st_size, PROT_READ) != 0)
+    {
+        int err = errno;
+        close(fd);
+        errno = err;
+        return -1;
+    }
+
+    const LatestFrameHeader *h = f->header;
+    if ((size_t)st.st_size < sizeof(LatestFrameHeader) || __atomic_load_n(&h->magic, __ATOMIC_ACQUIRE) != LATEST_FRAME_MAGIC ||
+        h->version != LATEST_FRAME_VERSION || h->bytes > (size_t)st.st_size ||
+        h->analogOffset + (size_t)h->analogCols * sizeof(float) > h->bytes || h->boolOffset + (size_t)h->boolCols > h->bytes)
+    {
+        latestClose(f);
+        errno = EPROTO;
+        return -1;
+    }
+    f->analogs = (float *)((char *)f->header + h->analogOffset);
+    f->bools = (uint8_t *)f->header + h->boolOffset;
+    return 0;
+}
+
+static int inRange(const int *cols, int n, uint32_t limit)
+{
+    for (int i = 0; cols != NULL && i < n; ++i)
+    {
+        if (cols[i] < 0 || (uint32_t)cols[i] >= limit)
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+int64_t latestRead(const LatestFrame *f, const int *analogCols, int nAnalogs, float *analogs, const int *boolCols,
+                   int nBools, uint8_t *bools)
+{
+    const LatestFrameHeader *h = f->header;
+    if (!inRange(analogCols, nAnalogs, h->analogCols) || !inRange(boolCols, nBools, h->boolCols))
+    {
+        errno = EINVAL;
+        return -1;
+    }
+    for (int tries = 0; tries < LATEST_FRAME_READ_TRIES; ++tries)
+    {
+        uint64_t seq = __atomic_load_n(&h->seq, __ATOMIC_ACQUIRE);
+        if (seq & 1)
+        {
+            sched_yield();
+            continue;
+        }
+        if (analogs != NULL && analogCols == NULL)
+        {
+            memcpy(analogs, f->analogs, h->analogCols * sizeof(float));
+        }
+        for (int i = 0; analogs != NULL && analogCols != NULL && i < nAnalogs; ++i)
+        {
+            analogs[i] = f->analogs[analogCols[i]];
+        }
+        if (bools != NULL && boolCols == NULL)
+        {
+            memcpy(bools, f->bools, h->boolCols);
+        }
+        for (int i = 0; bools != NULL && boolCols != NULL && i < nBools; ++i)
+        {
+            bools[i] = f->bools[boolCols[i]];
+        }
+        int64_t millis = h->millis;
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&h->seq, __ATOMIC_RELAXED) == seq)
+        {
+            return millis;
+        }
+    }
+    errno = EAGAIN;
+    return -1;
+}
+
+int latestReplaced(const LatestFrame *f)
+{
+    struct stat st;
+    return f->fd != -1 && (fstat(f->fd, &st) != 0 || st.st_nlink == 0);
+}
+
+void latestClose(LatestFrame *f)
+{
+    munmap(f->header, f->bytes);
+    if (f->fd != -1)
+    {
+        close(f->fd);
+    }
+    f->header = NULL;
+    f->fd = -1;
+}
@@ -0,0 +1,87 @@
+#ifndef LATEST_FRAME_H
+#define LATEST_FRAME_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// The latest decoded frame of one device in POSIX shared memory, for local
+// readers that want current values without a database round-trip. The
+// acquisition writes each frame between two increments of `seq`, a seqlock:
+// readers copy what they need and retry if `seq` was odd or moved meanwhile,
+// so neither side ever blocks the other. C, so other languages can load it
+// as a shared library.
+//
+// Segment layout, host byte order:
+//   LatestFrameHeader               at 0
+//   float   analogs[analogCols]     at analogOffset, engineering units; column i is c<i> of s_analog
+//   uint8_t bools[boolCols]         at boolOffset, 0 or 1; column i is c<i> of s_bool
+// Any change to it gets a new LATEST_FRAME_VERSION, and readers refuse
+// versions they do not know.
+
+#define LATEST_FRAME_MAGIC 0x48324c46u // "H2LF"
+#define LATEST_FRAME_VERSION 1
+// Copies a reader attempts while the writer keeps getting in the way
+#define LATEST_FRAME_READ_TRIES 1000
+
+typedef struct LatestFrameHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    int32_t device;
+    uint32_t analogCols;
+    uint32_t boolCols;
+    uint32_t analogOffset;
+    uint32_t boolOffset;
+    uint32_t bytes; // the whole segment
+    uint64_t seq;   // odd while a frame is written; only through __atomic builtins
+    int64_t millis; // timestamp of the frame, 0 before the first
+    uint64_t frames; // written since the segment was created
+} LatestFrameHeader;
+
+// A mapping of one segment, for either side
+typedef struct LatestFrame
+{
+    int fd;
+    size_t bytes;
+    LatestFrameHeader *header;
+    float *analogs;
+    uint8_t *bools;
+} LatestFrame;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Writer: creates segment `name` (e.g. "/h2_latest_1"), replacing one left
+// by an earlier run, or with `name` NULL the same layout in memory private to
+// this process. 0, or -1 with errno set.
+int latestCreate(LatestFrame *f, const char *name, int device, int analogCols, int boolCols);
+
+// Bracket every write of f->analogs and f->bools; one writer per segment
+void latestBeginWrite(LatestFrame *f);
+
+void latestEndWrite(LatestFrame *f, int64_t millis);
+
+// Reader: maps segment `name` read only. 0, or -1 with errno set, EPROTO for
+// a layout this reader does not know.
+int latestOpen(LatestFrame *f, const char *name);
+
+// Copies the columns listed in analogCols (nAnalogs of them) to analogs and
+// those in boolCols to bools, all from the same frame. A NULL column list
+// copies every column of its kind, a NULL destination none. Returns the
+// frame's timestamp, 0 if none was written yet, or -1 with errno EINVAL for
+// a column out of range or EAGAIN if the writer kept overwriting it.
+int64_t latestRead(const LatestFrame *f, const int *analogCols, int nAnalogs, float *analogs, const int *boolCols,
+                   int nBools, uint8_t *bools);
+
+// 1 once the writer has replaced or removed the segment: close and open it
+// again to follow a restarted acquisition
+int latestReplaced(const LatestFrame *f);
+
+void latestClose(LatestFrame *f);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LATEST_FRAME_H
@@ -0,0 +1,161 @@
+#ifndef LINE_PROTOCOL_H
+#define LINE_PROTOCOL_H
+
+#include <math.h>
+#include <string.h>
+#include <charconv>
+#include <string>
+#include <vector>
+#include "taos.h"
+#include "device.h"
+
+// Longest a field value takes, e.g. -3.4028235e+38f32
+#define LINE_VALUE_BYTES 24
+// Measurement aside, the longest rest of a line: ",dev=<int>,tname=<subtable> ", "<ts>" and NUL
+#define LINE_ROW_BYTES (32 + sizeof(SubtableName::name))
+
+// Everything about a supertable's lines that does not change between rows,
+// built once per writer
+struct LineSchema
+{
+    std::string measurement;       // s_<kind><stable>
+    std::vector<std::string> keys; // "<column>=" per column
+    std::vector<int> types;        // TSDB_DATA_TYPE_* per column
+    size_t rowBytes;               // most a line can take
+};
+
+// Lines of one insert, formatted in place: `lines` point into `text`, each
+// line NUL-terminated. Both only grow, so a writer stops allocating once it
+// has seen its largest batch.
+struct LineBuffer
+{
+    std::vector<char> text;
+    std::vector<char *> lines;
+};
+
+// Columns are `names` when given, c0, c1, ... otherwise; `types` overrides
+// `type` per column as for stmtFor
+inline void lineSchema(LineSchema &s, const char *kind, const std::string &stable, int cols, int type,
+                       const std::vector<std::string> &names, const std::vector<int> &types)
+{
+    s.measurement = "s_" + std::string(kind) + stable;
+    s.keys.resize(cols);
+    s.types.resize(cols);
+    s.rowBytes = s.measurement.size() + LINE_ROW_BYTES;
+    for (int c = 0; c < cols; ++c)
+    {
+        s.keys[c] = (names.empty() ? "c" + std::to_string(c) : names[c]) + "=";
+        s.types[c] = types.empty() ? type : types[c];
+        s.rowBytes += s.keys[c].size() + LINE_VALUE_BYTES + 1;
+    }
+}
+
+// Appends the value with the type suffix of the line protocol; false for
+// one it cannot carry (NaN, infinity), which is left out like a NULL
+inline bool lineValue(char *&p, char *end, float v, int)
+{
+    if (!isfinite(v))
+    {
+        return false;
+    }
+    p = std::to_chars(p, end, v).ptr;
+    memcpy(p, "f32", 3);
+    p += 3;
+    return true;
+}
+
+inline bool lineValue(char *&p, char *, uint8_t v, int)
+{
+    *p++ = v ? 't' : 'f';
+    return true;
+}
+
+inline bool lineValue(char *&p, char *end, uint16_t v, int type)
+{
+    if (type == TSDB_DATA_TYPE_SMALLINT)
+    {
+        p = std::to_chars(p, end, (int16_t)v).ptr;
+        memcpy(p, "i16", 3);
+    }
+    else
+    {
+        p = std::to_chars(p, end, v).ptr;
+        memcpy(p, "u16", 3);
+    }
+    p += 3;
+    return true;
+}
+
+inline bool lineValue(char *&p, char *end, int32_t v, int)
+{
+    p = std::to_chars(p, end, v).ptr;
+    memcpy(p, "i32", 3);
+    p += 3;
+    return true;
+}
+
+// Formats every row of `data` as one line
+//   s_<kind><stable>,dev=<id>,tname=<table><kind><yyyymmdd> c0=1.5f32,c7=t 1700000000000
+// with the device's daily subtable as the tname tag. NULL columns are left
+// out; a row left with none is skipped. Returns the number of lines.
+template <typename T>
+int formatLines(LineBuffer &b, const LineSchema &s, const ColumnBatch<T> &data, SubtableName &names,
+                const std::string &table, const char *kind, int dev)
+{
+    if (b.text.size() < (size_t)data.count * s.rowBytes)
+    {
+        b.text.resize((size_t)data.count * s.rowBytes);
+    }
+    if (b.lines.size() < (size_t)data.count)
+    {
+        b.lines.resize(data.count);
+    }
+    char *p = b.text.data();
+    char *end = p + b.text.size();
+    int n = 0;
+    for (int r = 0; r < data.count; ++r)
+    {
+        char *line = p;
+        memcpy(p, s.measurement.data(), s.measurement.size());
+        p += s.measurement.size();
+        memcpy(p, ",dev=", 5);
+        p = std::to_chars(p + 5, end, dev).ptr;
+        memcpy(p, ",tname=", 7);
+        const char *tname = subtableName(names, table, kind, data.ts[r]);
+        size_t len = strlen(tname);
+        memcpy(p + 7, tname, len);
+        p += 7 + len;
+        *p++ = ' ';
+
+        char *fields = p;
+        for (int c = 0; c < data.cols; ++c)
+        {
+            size_t at = (size_t)c * data.capacity + r;
+            if (data.nulls[at])
+            {
+                continue;
+            }
+            char *field = p;
+            memcpy(p, s.keys[c].data(), s.keys[c].size());
+            p += s.keys[c].size();
+            if (!lineValue(p, end, data.data[at], s.types[c]))
+            {
+                p = field;
+                continue;
+            }
+            *p++ = ',';
+        }
+        if (p == fields)
+        {
+            p = line;
+            continue;
+        }
+        p[-1] = ' ';
+        p = std::to_chars(p, end, data.ts[r]).ptr;
+        *p++ = '\0';
+        b.lines[n++] = line;
+    }
+    return n;
+}
+
+#endif // LINE_PROTOCOL_H
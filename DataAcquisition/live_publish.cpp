@@ -0,0 +1,157 @@
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <charconv>
+#include "live_publish.h"
+#include "change_filter.h"
+#include "metrics.h"
+#include "poll_schedule.h"
+
+// Longest a column can take in a message: "c<col>":<shortest float>,
+#define LIVE_ANALOG_BYTES 32
+#define LIVE_BOOL_BYTES 16
+#define LIVE_HEADER_BYTES 128
+
+void liveAdd(LivePublisher &p, int id, const LatestFrame &frame, const std::vector<Deadband> &bands,
+             const std::string &topic)
+{
+    p.devices.emplace_back();
+    LiveDevice &ld = p.devices.back();
+    int analogCols = frame.header->analogCols;
+    int boolCols = frame.header->boolCols;
+    ld.id = id;
+    ld.frame = &frame;
+    ld.topic = topic;
+    ld.bands.assign(analogCols, Deadband());
+    for (int i = 0; i < analogCols && i < (int)bands.size(); ++i)
+    {
+        if (bands[i].enabled)
+        {
+            ld.bands[i] = bands[i];
+        }
+    }
+    ld.analogs.assign(analogCols, 0);
+    ld.bools.assign(boolCols, 0);
+    ld.sentAnalogs.assign(analogCols, 0);
+    ld.sentBools.assign(boolCols, 0);
+    ld.sentMillis = 0;
+    ld.keyAt = 0;
+    ld.seq = 0;
+    ld.message.resize(LIVE_HEADER_BYTES + (size_t)analogCols * LIVE_ANALOG_BYTES + (size_t)boolCols * LIVE_BOOL_BYTES);
+}
+
+// Appends "c<col>":, by hand like the values: snprintf per column takes
+// longer than all the rest of a keyframe
+static char *appendKey(char *p, char *end, size_t col)
+{
+    memcpy(p, "\"c", 2);
+    p = std::to_chars(p + 2, end, col).ptr;
+    memcpy(p, "\":", 2);
+    return p + 2;
+}
+
+int liveFormat(LiveDevice &ld, int64_t now, int keyframeMs)
+{
+    int64_t millis = latestRead(ld.frame, NULL, 0, ld.analogs.data(), NULL, 0, ld.bools.data());
+    bool key = ld.seq == 0 || now >= ld.keyAt;
+    if (millis <= 0 || (!key && millis == ld.sentMillis))
+    {
+        return 0;
+    }
+
+    char *start = ld.message.data();
+    char *end = start + ld.message.size();
+    char *p = start + snprintf(start, end - start, "{\"dev\":%d,\"ts\":%lld,\"seq\":%llu,\"key\":%d,\"a\":{", ld.id,
+                               (long long)millis, (unsigned long long)ld.seq + 1, key ? 1 : 0);
+    char *first = p;
+    for (size_t i = 0; i < ld.analogs.size(); ++i)
+    {
+        float v = ld.analogs[i];
+        if (!key && !changed(v, ld.sentAnalogs[i], ld.bands[i]))
+        {
+            continue;
+        }
+        ld.sentAnalogs[i] = v;
+        p = appendKey(p, end, i);
+        if (isfinite(v))
+        {
+            p = std::to_chars(p, end, v).ptr;
+        }
+        else
+        {
+            memcpy(p, "null", 4);
+            p += 4;
+        }
+        *p++ = ',';
+    }
+    bool any = p != first;
+    p -= any ? 1 : 0;
+    p += snprintf(p, end - p, "},\"b\":{");
+    first = p;
+    for (size_t i = 0; i < ld.bools.size(); ++i)
+    {
+        uint8_t v = ld.bools[i];
+        if (!key && v == ld.sentBools[i])
+        {
+            continue;
+        }
+        ld.sentBools[i] = v;
+        p = appendKey(p, end, i);
+        *p++ = v ? '1' : '0';
+        *p++ = ',';
+    }
+    any = any || p != first;
+    p -= p != first ? 1 : 0;
+    p += snprintf(p, end - p, "}}");
+
+    ld.sentMillis = millis;
+    if (!key && !any)
+    {
+        return 0;
+    }
+    if (key)
+    {
+        ld.keyAt = now + (int64_t)keyframeMs * 1000000;
+    }
+    ++ld.seq;
+    return (int)(p - start);
+}
+
+static void runLive(LivePublisher &p)
+{
+    MetricCounter &keyframes = metricCounter("live_keyframes");
+    MetricCounter &deltas = metricCounter("live_deltas");
+    PollSchedule tick;
+    scheduleStart(tick, monotonicNs(), (int64_t)p.periodMs * 1000000, OVERRUN_SKIP);
+    while (p.running.load(std::memory_order_relaxed))
+    {
+        sleepUntil(tick.next);
+        int64_t now = monotonicNs();
+        scheduleFire(tick, now);
+        for (LiveDevice &ld : p.devices)
+        {
+            bool key = ld.seq == 0 || now >= ld.keyAt;
+            int len = liveFormat(ld, now, p.keyframeMs);
+            if (len > 0)
+            {
+                p.send(ld.topic, ld.message.data(), len);
+                (key ? keyframes : deltas).add();
+            }
+        }
+    }
+}
+
+void liveStart(LivePublisher &p)
+{
+    p.running = true;
+    p.thread = std::thread([&p] { runLive(p); });
+}
+
+void liveStop(LivePublisher &p)
+{
+    p.running = false;
+    if (p.thread.joinable())
+    {
+        p.thread.join();
+    }
+}
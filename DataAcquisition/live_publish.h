@@ -0,0 +1,65 @@
+#ifndef LIVE_PUBLISH_H
+#define LIVE_PUBLISH_H
+
+#include <stdint.h>
+#include <atomic>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+#include "register_map.h"
+#include "latest_frame.h"
+
+#define DEFAULT_LIVE_KEYFRAME_S 60
+
+// Hands one message on, e.g. to MQTT; `payload` is only valid during the call
+typedef std::function<void(const std::string &topic, const char *payload, int len)> LiveSender;
+
+// Live values of one device, taken from its latest frame in memory. Messages
+// are JSON, e.g.
+//   {"dev":1,"ts":1700000000000,"seq":42,"key":0,"a":{"c34":0.98},"b":{"c159":1}}
+// A keyframe ("key":1) carries every column, a delta only the columns that
+// moved out of their deadband since they were last sent. seq counts the
+// device's messages, so a reader that misses one waits for the next keyframe.
+// NaN and infinite analogs are sent as null.
+struct LiveDevice
+{
+    int id;
+    const LatestFrame *frame;
+    std::string topic;
+    std::vector<Deadband> bands; // per analog; columns without one are sent on any change
+    std::vector<float> analogs;
+    std::vector<uint8_t> bools;
+    std::vector<float> sentAnalogs;
+    std::vector<uint8_t> sentBools;
+    int64_t sentMillis; // frame last sent from, 0 before the first
+    int64_t keyAt;      // monotonic ns the next keyframe is due
+    uint64_t seq;
+    std::vector<char> message; // sized for a keyframe
+};
+
+// Publishes every device every `periodMs` from its own thread, a keyframe
+// every `keyframeMs` and deltas in between; a device with no new frame or
+// no change sends nothing
+struct LivePublisher
+{
+    int periodMs;
+    int keyframeMs = DEFAULT_LIVE_KEYFRAME_S * 1000;
+    LiveSender send;
+    std::vector<LiveDevice> devices;
+    std::thread thread;
+    std::atomic<bool> running{false};
+};
+
+void liveAdd(LivePublisher &p, int id, const LatestFrame &frame, const std::vector<Deadband> &bands,
+             const std::string &topic);
+
+// Formats the device's next message from its latest frame into ld.message
+// and returns its length, 0 when there is nothing to send. Does not allocate.
+int liveFormat(LiveDevice &ld, int64_t now, int keyframeMs);
+
+void liveStart(LivePublisher &p);
+
+void liveStop(LivePublisher &p);
+
+#endif // LIVE_PUBLISH_H
@@ -0,0 +1,277 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Process-wide counters, gauges and latency histograms, shared by the
+// acquisition service and the Mechanism service (header only). Recording is
+// a few relaxed atomic operations and never locks or allocates, so it can sit
+// on the poll and insert paths. Metrics are created by name once and the
+// reference kept; metricsText() renders all of them in the Prometheus text
+// format, for a node_exporter textfile collector or an MQTT topic.
+
+// Histogram buckets: 1 ns wide below 2^METRICS_SUB_BITS ns, then
+// 2^METRICS_SUB_BITS per power of two, so a percentile is within 3% of the
+// true value; latencies from 2^METRICS_MAX_BITS ns (18 minutes) on are
+// counted in the last bucket
+#define METRICS_SUB_BITS 5
+#define METRICS_MAX_BITS 40
+#define METRICS_BUCKETS ((METRICS_MAX_BITS - METRICS_SUB_BITS + 1) << METRICS_SUB_BITS)
+
+inline int64_t metricsNowNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+struct MetricCounter
+{
+    std::string name;
+    std::atomic<uint64_t> value{0};
+
+    void add(uint64_t n = 1)
+    {
+        value.fetch_add(n, std::memory_order_relaxed);
+    }
+};
+
+struct MetricGauge
+{
+    std::string name;
+    std::atomic<int64_t> value{0};
+
+    void set(int64_t v)
+    {
+        value.store(v, std::memory_order_relaxed);
+    }
+};
+
+// Latencies in ns. count and sum run from the start; buckets and max from
+// the last snapshot, so percentiles describe one export period.
+struct LatencyHistogram
+{
+    std::string name;
+    std::atomic<uint64_t> count{0};
+    std::atomic<uint64_t> sumNs{0};
+    std::atomic<uint64_t> maxNs{0};
+    std::atomic<uint64_t> buckets[METRICS_BUCKETS];
+
+    LatencyHistogram()
+    {
+        for (std::atomic<uint64_t> &b : buckets)
+        {
+            b.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    static int bucketOf(uint64_t ns)
+    {
+        if (ns < (1u << METRICS_SUB_BITS))
+        {
+            return (int)ns;
+        }
+        if (ns >= (1ull << METRICS_MAX_BITS))
+        {
+            ns = (1ull << METRICS_MAX_BITS) - 1;
+        }
+        int shift = 63 - __builtin_clzll(ns) - METRICS_SUB_BITS;
+        return (shift << METRICS_SUB_BITS) + (int)(ns >> shift);
+    }
+
+    // Largest latency that falls in bucket `i`
+    static uint64_t bucketTop(int i)
+    {
+        if (i < (1 << METRICS_SUB_BITS))
+        {
+            return (uint64_t)i;
+        }
+        int shift = (i >> METRICS_SUB_BITS) - 1;
+        uint64_t sub = (uint64_t)(i - (shift << METRICS_SUB_BITS));
+        return ((sub + 1) << shift) - 1;
+    }
+
+    void record(int64_t ns)
+    {
+        uint64_t v = ns > 0 ? (uint64_t)ns : 0;
+        buckets[bucketOf(v)].fetch_add(1, std::memory_order_relaxed);
+        count.fetch_add(1, std::memory_order_relaxed);
+        sumNs.fetch_add(v, std::memory_order_relaxed);
+        uint64_t max = maxNs.load(std::memory_order_relaxed);
+        while (v > max && !maxNs.compare_exchange_weak(max, v, std::memory_order_relaxed))
+        {
+        }
+    }
+};
+
+// Records the time from construction to the end of the scope
+struct MetricTimer
+{
+    LatencyHistogram &histogram;
+    int64_t start;
+
+    explicit MetricTimer(LatencyHistogram &h) : histogram(h), start(metricsNowNs())
+    {
+    }
+
+    ~MetricTimer()
+    {
+        histogram.record(metricsNowNs() - start);
+    }
+};
+
+// The period of one histogram since the previous snapshot
+struct HistogramSnapshot
+{
+    uint64_t count = 0;
+    uint64_t maxNs = 0;
+    std::vector<uint64_t> buckets;
+
+    // Nearest rank; the top of its bucket, but never above the max
+    uint64_t percentileNs(double p) const
+    {
+        uint64_t rank = (uint64_t)(p / 100 * count);
+        uint64_t seen = 0;
+        for (size_t i = 0; i < buckets.size(); ++i)
+        {
+            seen += buckets[i];
+            if (seen > rank)
+            {
+                uint64_t top = LatencyHistogram::bucketTop((int)i);
+                return top < maxNs ? top : maxNs;
+            }
+        }
+        return maxNs;
+    }
+};
+
+// Starts the next period. Values recorded meanwhile land in either one.
+inline HistogramSnapshot snapshotHistogram(LatencyHistogram &h)
+{
+    HistogramSnapshot s;
+    s.buckets.resize(METRICS_BUCKETS);
+    for (int i = 0; i < METRICS_BUCKETS; ++i)
+    {
+        s.buckets[i] = h.buckets[i].exchange(0, std::memory_order_relaxed);
+        s.count += s.buckets[i];
+    }
+    s.maxNs = h.maxNs.exchange(0, std::memory_order_relaxed);
+    return s;
+}
+
+// Deques, so references handed out stay valid as metrics are added
+struct MetricsRegistry
+{
+    std::mutex lock; // creating metrics and exporting; recording never takes it
+    std::deque<MetricCounter> counters;
+    std::deque<MetricGauge> gauges;
+    std::deque<LatencyHistogram> histograms;
+};
+
+inline MetricsRegistry &metrics()
+{
+    static MetricsRegistry registry;
+    return registry;
+}
+
+template <typename M>
+M &metricNamed(std::deque<M> &all, const std::string &name)
+{
+    std::lock_guard<std::mutex> hold(metrics().lock);
+    for (M &m : all)
+    {
+        if (m.name == name)
+        {
+            return m;
+        }
+    }
+    all.emplace_back();
+    all.back().name = name;
+    return all.back();
+}
+
+// The metric called `name`, created on first use. Names follow Prometheus
+// rules ([a-z_][a-z0-9_]*); keep the reference rather than looking it up on
+// a hot path, e.g. in a function-local static.
+inline MetricCounter &metricCounter(const std::string &name)
+{
+    return metricNamed(metrics().counters, name);
+}
+
+inline MetricGauge &metricGauge(const std::string &name)
+{
+    return metricNamed(metrics().gauges, name);
+}
+
+inline LatencyHistogram &metricHistogram(const std::string &name)
+{
+    return metricNamed(metrics().histograms, name);
+}
+
+// Counters as <name>_total, gauges as <name>, histograms as summaries
+// <name>_seconds with p50, p90, p99 and p99.9 of the period since the
+// previous call, plus <name>_seconds_max of that period. Call it from one
+// place only, as it starts the next period.
+inline std::string metricsText()
+{
+    MetricsRegistry &r = metrics();
+    std::lock_guard<std::mutex> hold(r.lock);
+    std::string out;
+    char line[256];
+    for (MetricCounter &c : r.counters)
+    {
+        snprintf(line, sizeof(line), "# TYPE %s_total counter\n%s_total %lu\n", c.name.c_str(), c.name.c_str(),
+                 (unsigned long)c.value.load(std::memory_order_relaxed));
+        out += line;
+    }
+    for (MetricGauge &g : r.gauges)
+    {
+        snprintf(line, sizeof(line), "# TYPE %s gauge\n%s %ld\n", g.name.c_str(), g.name.c_str(),
+                 (long)g.value.load(std::memory_order_relaxed));
+        out += line;
+    }
+    static const double quantiles[] = {50, 90, 99, 99.9};
+    for (LatencyHistogram &h : r.histograms)
+    {
+        HistogramSnapshot s = snapshotHistogram(h);
+        const char *name = h.name.c_str();
+        snprintf(line, sizeof(line), "# TYPE %s_seconds summary\n", name);
+        out += line;
+        for (double q : quantiles)
+        {
+            if (s.count > 0)
+            {
+                snprintf(line, sizeof(line), "%s_seconds{quantile=\"%g\"} %.9f\n", name, q / 100, s.percentileNs(q) / 1e9);
+                out += line;
+            }
+        }
+        snprintf(line, sizeof(line), "%s_seconds_sum %.9f\n%s_seconds_count %lu\n%s_seconds_max %.9f\n", name,
+                 h.sumNs.load(std::memory_order_relaxed) / 1e9, name, (unsigned long)h.count.load(std::memory_order_relaxed),
+                 name, s.maxNs / 1e9);
+        out += line;
+    }
+    return out;
+}
+
+// Replaces `path` in one step, so a collector never reads half a snapshot
+inline bool metricsWriteFile(const std::string &path, const std::string &text)
+{
+    std::string tmp = path + ".tmp";
+    FILE *f = fopen(tmp.c_str(), "w");
+    if (f == NULL)
+    {
+        return false;
+    }
+    bool ok = fwrite(text.data(), 1, text.size(), f) == text.size();
+    ok = fclose(f) == 0 && ok;
+    return ok && rename(tmp.c_str(), path.c_str()) == 0;
+}
+
+#endif // METRICS_H
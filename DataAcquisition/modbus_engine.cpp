@@ -0,0 +1,667 @@
+#include <algorithm>
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+#include "modbus_engine.h"
+#include "alloc_counter.h"
+#include "easylogging++.h"
+
+#define ENGINE_MAX_EVENTS 64
+// Upper bound on one epoll_wait, so engineStop is noticed promptly
+#define ENGINE_MAX_WAIT_MS 100
+#define NS_PER_MS 1000000
+
+static int64_t wallMs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+FailureClass classifyFailure(int err)
+{
+    if (err >= EMBXILFUN && err < EMBBADCRC)
+    {
+        return FAIL_EXCEPTION;
+    }
+    switch (err)
+    {
+    case ETIMEDOUT:
+        return FAIL_TIMEOUT;
+    case EMBBADDATA:
+    case EMBBADCRC:
+    case EMBBADSLAVE:
+    case EMBMDATA:
+        return FAIL_PROTOCOL;
+    case EINVAL:
+    case EAFNOSUPPORT:
+        return FAIL_CONFIG;
+    default:
+        return FAIL_CONNECTION;
+    }
+}
+
+static const char *linkName(const ModbusLink &l)
+{
+    return &l == &l.session->links[0] ? "" : " standby";
+}
+
+static void watch(EngineWorker &w, ModbusLink &l, int op)
+{
+    ModbusSession &s = *l.session;
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    if (l.connecting || (&l == &s.links[s.active] && s.wantWrite))
+    {
+        ev.events |= EPOLLOUT;
+    }
+    ev.data.ptr = &l;
+    epoll_ctl(w.epfd, op, l.fd, &ev);
+}
+
+static void closeLink(EngineWorker &w, ModbusLink &l)
+{
+    if (l.fd >= 0)
+    {
+        epoll_ctl(w.epfd, EPOLL_CTL_DEL, l.fd, NULL);
+        close(l.fd);
+        l.fd = -1;
+    }
+    l.connecting = false;
+}
+
+static bool linkUp(const ModbusLink &l)
+{
+    return l.fd >= 0 && !l.connecting;
+}
+
+// Drops the connection and schedules its reconnect: unanswered transactions
+// may still be on the wire, so it never carries on with a new cycle
+static void linkDown(EngineWorker &w, ModbusLink &l, int err, int64_t now, const ModbusEngine &engine)
+{
+    ModbusSession &s = *l.session;
+    if (l.failures++ == 0 || l.lastError != err)
+    {
+        printf("Device %d (%s:%d%s) failed: %s\n", s.id, l.ip.c_str(), l.port, linkName(l), modbus_strerror(err));
+        LOG(WARNING) << "Device " << s.id << " (" << l.ip << ":" << l.port << linkName(l) << ") failed: " << modbus_strerror(err);
+    }
+    l.lastError = err;
+    closeLink(w, l);
+    if (&l == &s.links[s.active])
+    {
+        s.wantWrite = false;
+    }
+    l.backoffMs = classifyFailure(err) == FAIL_CONFIG ? engine.reconnectMaxMs
+                  : l.backoffMs == 0                 ? engine.reconnectMinMs
+                                                     : std::min(2 * l.backoffMs, engine.reconnectMaxMs);
+    l.retryAt = now + (int64_t)l.backoffMs * NS_PER_MS;
+}
+
+static void openLink(EngineWorker &w, ModbusLink &l, int64_t now, const ModbusEngine &engine)
+{
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(l.port);
+    if (inet_pton(AF_INET, l.ip.c_str(), &addr.sin_addr) != 1)
+    {
+        linkDown(w, l, EINVAL, now, engine);
+        return;
+    }
+
+    l.fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (l.fd < 0)
+    {
+        linkDown(w, l, errno, now, engine);
+        return;
+    }
+    int one = 1;
+    setsockopt(l.fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    if (connect(l.fd, (struct sockaddr *)&addr, sizeof(addr)) == -1 && errno != EINPROGRESS)
+    {
+        linkDown(w, l, errno, now, engine);
+        return;
+    }
+    l.connecting = true;
+    l.deadline = now + (int64_t)engine.connectTimeoutMs * NS_PER_MS;
+    watch(w, l, EPOLL_CTL_ADD);
+}
+
+static void missSample(ModbusSession &s, int err, const ModbusEngine &engine)
+{
+    s.state = SESSION_IDLE;
+    s.missed.fetch_add(1, std::memory_order_relaxed);
+    if (engine.onMissed)
+    {
+        engine.onMissed(s, s.slotStart, err);
+    }
+}
+
+// Why no link could take a poll: the last failure of the active one
+static int downError(const ModbusSession &s)
+{
+    int err = s.links[s.active].lastError;
+    return err != 0 ? err : s.links[1 - s.active].lastError != 0 ? s.links[1 - s.active].lastError : ENOTCONN;
+}
+
+// Sends until the window is full or the socket pushes back
+static bool pumpRequests(EngineWorker &w, ModbusSession &s, int64_t now, const ModbusEngine &engine);
+
+static void startCycle(EngineWorker &w, ModbusSession &s, int64_t now, const ModbusEngine &engine)
+{
+    s.state = SESSION_READING;
+    s.allocMark = threadAllocations();
+    s.cycleStart = wallMs();
+    s.cycleStartNs = monotonicNs();
+    s.deadline = now + (int64_t)engine.responseTimeoutMs * NS_PER_MS;
+    s.base = (uint16_t)(s.base + s.dev.reads.size());
+    s.sent = 0;
+    s.done = 0;
+    s.cycleError = 0;
+    std::fill(s.pending.begin(), s.pending.end(), 0);
+    s.txLen = 0;
+    s.txOff = 0;
+    s.fill = 0;
+    pumpRequests(w, s, now, engine);
+}
+
+// The active link failed mid-cycle: drop it and run the cycle again on the
+// other link if that is up, once per slot; otherwise the sample is missed
+static void failCycle(EngineWorker &w, ModbusSession &s, int err, int64_t now, const ModbusEngine &engine)
+{
+    linkDown(w, s.links[s.active], err, now, engine);
+    int other = 1 - s.active;
+    if (s.nLinks == 2 && !s.failedOver && linkUp(s.links[other]))
+    {
+        s.active = other;
+        s.failedOver = true;
+        s.failovers.fetch_add(1, std::memory_order_relaxed);
+        watch(w, s.links[other], EPOLL_CTL_MOD);
+        startCycle(w, s, now, engine);
+        return;
+    }
+    missSample(s, err, engine);
+}
+
+static bool pumpRequests(EngineWorker &w, ModbusSession &s, int64_t now, const ModbusEngine &engine)
+{
+    ModbusLink &l = s.links[s.active];
+    int n = s.dueCount;
+    bool blocked = false;
+    while (!blocked)
+    {
+        if (s.txOff == s.txLen)
+        {
+            if (s.sent == n || s.sent - s.done >= s.dev.window)
+            {
+                break;
+            }
+            encodeReadRequest(s.tx, (uint16_t)(s.base + s.sent), s.dev.slave, s.dev.reads[s.due[s.sent]]);
+            s.pending[s.sent++] = 1;
+            s.txLen = MBAP_READ_REQUEST_LENGTH;
+            s.txOff = 0;
+        }
+        ssize_t k = send(l.fd, s.tx + s.txOff, s.txLen - s.txOff, MSG_NOSIGNAL);
+        if (k > 0)
+        {
+            s.txOff += (int)k;
+        }
+        else if (k == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        {
+            blocked = true;
+        }
+        else if (k == -1 && errno != EINTR)
+        {
+            failCycle(w, s, errno, now, engine);
+            return false;
+        }
+    }
+    if (blocked != s.wantWrite)
+    {
+        s.wantWrite = blocked;
+        watch(w, l, EPOLL_CTL_MOD);
+    }
+    return true;
+}
+
+static void onConnected(EngineWorker &w, ModbusLink &l, int64_t now, const ModbusEngine &engine)
+{
+    ModbusSession &s = *l.session;
+    int err = 0;
+    socklen_t len = sizeof(err);
+    getsockopt(l.fd, SOL_SOCKET, SO_ERROR, &err, &len);
+    if (err != 0)
+    {
+        linkDown(w, l, err, now, engine);
+        return;
+    }
+    l.connecting = false; // drops EPOLLOUT
+    watch(w, l, EPOLL_CTL_MOD);
+    if (l.failures > 0)
+    {
+        printf("Device %d (%s:%d%s) recovered\n", s.id, l.ip.c_str(), l.port, linkName(l));
+        LOG(INFO) << "Device " << s.id << " (" << l.ip << ":" << l.port << linkName(l) << ") recovered";
+        l.failures = 0;
+    }
+    l.backoffMs = 0;
+    if (s.state == SESSION_CONNECTING)
+    {
+        s.active = (int)(&l - s.links);
+        s.wantWrite = false;
+        startCycle(w, s, now, engine);
+    }
+}
+
+static void completeCycle(ModbusSession &s, const ModbusEngine &engine)
+{
+    ++s.cycles;
+    if (s.cycleError != 0)
+    {
+        // Every reply came, the connection is fine, but the frame is not whole
+        missSample(s, s.cycleError, engine);
+        return;
+    }
+    s.state = SESSION_IDLE;
+    if (engine.onFrame)
+    {
+        engine.onFrame(s, s.frame.data(), s.cycleStart);
+    }
+    s.changedReads = 0;
+    s.polledGroups = 0;
+    // After the first cycle, polling and hand-off must not touch the heap
+    uint64_t allocs = threadAllocations() - s.allocMark;
+    if (allocs > 0 && s.cycles > 1 && s.allocCycles++ == 0)
+    {
+        printf("Device %d: poll cycle made %lu heap allocations\n", s.id, (unsigned long)allocs);
+        LOG(WARNING) << "Device " << s.id << ": poll cycle made " << allocs << " heap allocations";
+    }
+}
+
+static void onReadable(EngineWorker &w, ModbusLink &l, int64_t now, const ModbusEngine &engine)
+{
+    ModbusSession &s = *l.session;
+    bool active = &l == &s.links[s.active] && s.state == SESSION_READING;
+    uint8_t drain[64];
+    ssize_t got = active ? recv(l.fd, s.rx + s.fill, sizeof(s.rx) - s.fill, 0) : recv(l.fd, drain, sizeof(drain), 0);
+    if (got <= 0)
+    {
+        if (got == -1 && (errno == EAGAIN || errno == EINTR))
+        {
+            return;
+        }
+        int err = got == 0 ? ECONNRESET : errno;
+        active ? failCycle(w, s, err, now, engine) : linkDown(w, l, err, now, engine);
+        return;
+    }
+    if (!active)
+    {
+        linkDown(w, l, EMBBADDATA, now, engine); // nothing is outstanding here
+        return;
+    }
+    s.fill += (int)got;
+
+    int off = 0;
+    int len;
+    while ((len = mbapFrameLength(s.rx + off, s.fill - off)) > 0)
+    {
+        int idx = (uint16_t)(mbapTransactionId(s.rx + off) - s.base);
+        if (idx >= s.sent || !s.pending[idx])
+        {
+            failCycle(w, s, EMBBADDATA, now, engine);
+            return;
+        }
+        int read = s.due[idx];
+        int changed = decodeReadReply(s.rx + off, len, s.dev.slave, s.dev.reads[read], s.frame.data());
+        if (changed == -1)
+        {
+            if (classifyFailure(errno) != FAIL_EXCEPTION)
+            {
+                failCycle(w, s, errno, now, engine);
+                return;
+            }
+            s.cycleError = errno;
+        }
+        if (changed == 1)
+        {
+            s.changedReads |= 1ull << std::min(read, 63);
+        }
+        s.pending[idx] = 0;
+        ++s.done;
+        off += len;
+        s.deadline = now + (int64_t)engine.responseTimeoutMs * NS_PER_MS;
+    }
+    if (len == -1)
+    {
+        failCycle(w, s, EMBBADDATA, now, engine);
+        return;
+    }
+    memmove(s.rx, s.rx + off, s.fill - off);
+    s.fill -= off;
+
+    if (s.done == s.dueCount)
+    {
+        completeCycle(s, engine);
+        return;
+    }
+    pumpRequests(w, s, now, engine);
+}
+
+// Poll groups due in `slot`, one bit each
+static uint64_t dueGroups(const ModbusSession &s, uint64_t slot)
+{
+    if (s.dev.groupEvery.empty())
+    {
+        return 1;
+    }
+    uint64_t groups = 0;
+    for (size_t g = 0; g < s.dev.groupEvery.size(); ++g)
+    {
+        if (slot % s.dev.groupEvery[g] == 0)
+        {
+            groups |= 1ull << g;
+        }
+    }
+    return groups;
+}
+
+// Picks the reads of the poll groups due in s.slot; false if none is.
+// Groups of a missed cycle stay in polledGroups, like its changed reads.
+static bool dueReads(ModbusSession &s)
+{
+    uint64_t groups = dueGroups(s, s.slot);
+    s.dueCount = 0;
+    for (int i = 0; i < (int)s.dev.reads.size(); ++i)
+    {
+        if ((groups >> s.dev.reads[i].group) & 1)
+        {
+            s.due[s.dueCount++] = i;
+        }
+    }
+    s.polledGroups |= groups;
+    return s.dueCount > 0;
+}
+
+// The `skipped` slots an overrun passed over after s.slot are missed samples
+// too, stamped when each came due; slots with no poll group due are not
+static void missSkipped(ModbusSession &s, int64_t skipped, int64_t now, const ModbusEngine &engine)
+{
+    int64_t wall = wallMs();
+    for (int64_t k = 1; k <= skipped; ++k)
+    {
+        if (dueGroups(s, s.slot + k) == 0)
+        {
+            continue;
+        }
+        int64_t due = s.schedule.next - (skipped - k + 1) * s.schedule.periodNs;
+        s.missed.fetch_add(1, std::memory_order_relaxed);
+        if (engine.onMissed)
+        {
+            engine.onMissed(s, wall - (now - due) / NS_PER_MS, ETIMEDOUT);
+        }
+    }
+}
+
+// A due poll goes to the primary link if it is up, else to the standby, so
+// polls fail back once the primary has reconnected; with neither up it waits
+// for one still connecting, or is missed
+static void startSlot(EngineWorker &w, ModbusSession &s, int64_t now, const ModbusEngine &engine)
+{
+    s.slotStart = wallMs();
+    s.failedOver = false;
+    for (int i = 0; i < s.nLinks; ++i)
+    {
+        if (linkUp(s.links[i]))
+        {
+            if (i != s.active)
+            {
+                s.active = i;
+                s.failovers.fetch_add(1, std::memory_order_relaxed);
+            }
+            startCycle(w, s, now, engine);
+            return;
+        }
+    }
+    for (int i = 0; i < s.nLinks; ++i)
+    {
+        if (s.links[i].connecting)
+        {
+            s.state = SESSION_CONNECTING;
+            return;
+        }
+    }
+    missSample(s, downError(s), engine);
+}
+
+// Slots are absolute monotonic times, so a late wake-up delays one poll but
+// never the ones after it; the timerfd wakes epoll_wait at ns resolution
+static void runWorker(ModbusEngine &engine, EngineWorker &w)
+{
+    struct epoll_event events[ENGINE_MAX_EVENTS];
+    while (engine.running.load(std::memory_order_relaxed))
+    {
+        int64_t now = monotonicNs();
+        int64_t wake = now + (int64_t)ENGINE_MAX_WAIT_MS * NS_PER_MS;
+        for (ModbusSession *s : w.sessions)
+        {
+            if (s->state == SESSION_READING && now >= s->deadline)
+            {
+                failCycle(w, *s, ETIMEDOUT, now, engine);
+            }
+            // Down links reconnect in the background, so the standby is warm
+            // and the PLC link is usually back before the next poll
+            for (int i = 0; i < s->nLinks; ++i)
+            {
+                ModbusLink &l = s->links[i];
+                if (l.connecting && now >= l.deadline)
+                {
+                    linkDown(w, l, ETIMEDOUT, now, engine);
+                }
+                if (l.fd < 0 && now >= l.retryAt)
+                {
+                    openLink(w, l, now, engine);
+                }
+                wake = std::min(wake, l.connecting ? l.deadline : l.fd < 0 ? l.retryAt : wake);
+            }
+            if (s->state == SESSION_CONNECTING && !s->links[0].connecting && !(s->nLinks == 2 && s->links[1].connecting))
+            {
+                missSample(*s, downError(*s), engine);
+            }
+            // A cycle still running when its next slot comes is an overrun;
+            // the policy decides whether the slots it missed are polled or
+            // reported missed
+            if (s->state == SESSION_IDLE && now >= s->schedule.next)
+            {
+                // Taken from the schedule, so skipped slots keep groups in step
+                s->slot = scheduleSlot(s->schedule);
+                missSkipped(*s, scheduleFire(s->schedule, now), now, engine);
+                // Slots where no poll group is due leave the session idle
+                if (dueReads(*s))
+                {
+                    startSlot(w, *s, now, engine);
+                }
+            }
+            wake = std::min(wake, s->state == SESSION_IDLE ? s->schedule.next
+                                  : s->state == SESSION_READING ? s->deadline : wake);
+        }
+
+        // Re-arming also clears an expiry nobody read
+        struct itimerspec at;
+        memset(&at, 0, sizeof(at));
+        at.it_value.tv_sec = wake / 1000000000;
+        at.it_value.tv_nsec = wake % 1000000000;
+        timerfd_settime(w.timerfd, TFD_TIMER_ABSTIME, &at, NULL);
+        int n = epoll_wait(w.epfd, events, ENGINE_MAX_EVENTS, ENGINE_MAX_WAIT_MS);
+        now = monotonicNs();
+        for (int i = 0; i < n; ++i)
+        {
+            if (events[i].data.ptr == NULL)
+            {
+                continue; // the timer
+            }
+            ModbusLink &l = *(ModbusLink *)events[i].data.ptr;
+            ModbusSession &s = *l.session;
+            if (l.fd < 0)
+            {
+                continue; // failed earlier in this batch
+            }
+            if (l.connecting)
+            {
+                if (events[i].events & (EPOLLOUT | EPOLLERR | EPOLLHUP))
+                {
+                    onConnected(w, l, now, engine);
+                }
+                continue;
+            }
+            if (events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP))
+            {
+                onReadable(w, l, now, engine);
+            }
+            if (l.fd >= 0 && &l == &s.links[s.active] && s.state == SESSION_READING && s.wantWrite &&
+                (events[i].events & EPOLLOUT))
+            {
+                pumpRequests(w, s, now, engine);
+            }
+        }
+    }
+    for (ModbusSession *s : w.sessions)
+    {
+        for (int i = 0; i < s->nLinks; ++i)
+        {
+            closeLink(w, s->links[i]);
+        }
+        s->state = SESSION_IDLE;
+    }
+}
+
+static void initLink(ModbusLink &l, ModbusSession *s, const std::string &ip, int port)
+{
+    l.session = s;
+    l.ip = ip;
+    l.port = port;
+    l.fd = -1;
+    l.connecting = false;
+    l.deadline = 0;
+    l.retryAt = 0;
+    l.backoffMs = 0;
+    l.failures = 0;
+    l.lastError = 0;
+}
+
+int engineAddSession(ModbusEngine &engine, const ModbusDevice &dev)
+{
+    std::unique_ptr<ModbusSession> s(new ModbusSession());
+    s->id = (int)engine.sessions.size();
+    s->dev = dev;
+    s->dev.window = std::max(dev.window, 1);
+    initLink(s->links[0], s.get(), dev.ip, dev.port);
+    initLink(s->links[1], s.get(), dev.standbyIp, dev.standbyPort);
+    s->nLinks = dev.standbyIp.empty() ? 1 : 2;
+    s->active = 0;
+    s->state = SESSION_IDLE;
+    s->pending.assign(dev.reads.size(), 0);
+    s->due.assign(dev.reads.size(), 0);
+    s->slot = 0;
+    s->polledGroups = 0;
+    s->frame.assign(dev.frameWords, 0);
+    s->changedReads = ~0ull;
+    engine.sessions.push_back(std::move(s));
+    return engine.sessions.back()->id;
+}
+
+void engineStart(ModbusEngine &engine, int threads)
+{
+    threads = std::max(1, std::min(threads, (int)engine.sessions.size()));
+    int64_t now = monotonicNs();
+    int64_t period = (int64_t)engine.periodMs * NS_PER_MS;
+    int count = (int)engine.sessions.size();
+    for (int t = 0; t < threads; ++t)
+    {
+        std::unique_ptr<EngineWorker> w(new EngineWorker());
+        w->epfd = epoll_create1(EPOLL_CLOEXEC);
+        if (w->epfd < 0)
+        {
+            printf("epoll_create1 failed: %s\n", strerror(errno));
+            LOG(ERROR) << "epoll_create1 failed: " << strerror(errno);
+            exit(EXIT_FAILURE);
+        }
+        w->timerfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        if (w->timerfd < 0)
+        {
+            printf("timerfd_create failed: %s\n", strerror(errno));
+            LOG(ERROR) << "timerfd_create failed: " << strerror(errno);
+            exit(EXIT_FAILURE);
+        }
+        struct epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.ptr = NULL;
+        epoll_ctl(w->epfd, EPOLL_CTL_ADD, w->timerfd, &ev);
+        engine.workers.push_back(std::move(w));
+    }
+    for (int i = 0; i < count; ++i)
+    {
+        ModbusSession &s = *engine.sessions[i];
+        // Spread first polls over one period so devices don't all fire at once
+        scheduleStart(s.schedule, now + period * i / count, period, engine.overrun);
+        engine.workers[i % threads]->sessions.push_back(&s);
+    }
+
+    engine.running = true;
+    for (auto &w : engine.workers)
+    {
+        EngineWorker *worker = w.get();
+        worker->thread = std::thread([&engine, worker] { runWorker(engine, *worker); });
+    }
+    printf("Modbus engine: %d devices on %d threads, every %d ms, overruns %s\n", count, threads, engine.periodMs,
+           engine.overrun == OVERRUN_CATCH_UP ? "caught up" : "skipped");
+    LOG(INFO) << "Modbus engine: " << count << " devices on " << threads << " threads, every " << engine.periodMs
+              << " ms, overruns " << (engine.overrun == OVERRUN_CATCH_UP ? "caught up" : "skipped");
+}
+
+void engineStop(ModbusEngine &engine)
+{
+    engine.running = false;
+    for (auto &w : engine.workers)
+    {
+        if (w->thread.joinable())
+        {
+            w->thread.join();
+        }
+        close(w->timerfd);
+        close(w->epfd);
+    }
+    engine.workers.clear();
+}
+
+void engineReport(ModbusEngine &engine)
+{
+    for (auto &s : engine.sessions)
+    {
+        PollSchedule &p = s->schedule;
+        uint64_t slots = p.slots.load(std::memory_order_relaxed);
+        double meanMs = slots > 0 ? (double)p.lateSumNs.load(std::memory_order_relaxed) / slots / NS_PER_MS : 0;
+        double maxMs = (double)p.lateMaxNs.exchange(0, std::memory_order_relaxed) / NS_PER_MS;
+        uint64_t overruns = p.overruns.load(std::memory_order_relaxed);
+        uint64_t skipped = p.skipped.load(std::memory_order_relaxed);
+        uint64_t missed = s->missed.load(std::memory_order_relaxed);
+        uint64_t failovers = s->failovers.load(std::memory_order_relaxed);
+        printf("Device %d: %lu polls, %lu missed, %lu failovers, %lu overruns, %lu slots skipped, started %.3f ms late on average, %.3f ms at worst\n",
+               s->id, (unsigned long)slots, (unsigned long)missed, (unsigned long)failovers, (unsigned long)overruns,
+               (unsigned long)skipped, meanMs, maxMs);
+        LOG(INFO) << "Device " << s->id << ": " << slots << " polls, " << missed << " missed, " << failovers << " failovers, "
+                  << overruns << " overruns, " << skipped << " slots skipped, started " << meanMs << " ms late on average, "
+                  << maxMs << " ms at worst";
+    }
+}
+
+ModbusEngine::~ModbusEngine()
+{
+    engineStop(*this);
+}
@@ -0,0 +1,169 @@
+#ifndef MODBUS_ENGINE_H
+#define MODBUS_ENGINE_H
+
+#include <stdint.h>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "modbus_read.h"
+#include "modbus_pipeline.h"
+#include "poll_schedule.h"
+
+#define DEFAULT_ENGINE_THREADS 1
+#define DEFAULT_POLL_PERIOD_MS 1000
+#define DEFAULT_RESPONSE_TIMEOUT_MS 200
+#define DEFAULT_CONNECT_TIMEOUT_MS 1000
+// A connection that failed is retried after this, doubled on every further
+// failure up to the max; a connection that succeeds starts over
+#define DEFAULT_RECONNECT_MIN_MS 250
+#define DEFAULT_RECONNECT_MAX_MS 30000
+
+// What to poll on one PLC
+struct ModbusDevice
+{
+    std::string ip;
+    int port;
+    std::string standbyIp; // second connection kept open to switch to, "" for none
+    int standbyPort;
+    int slave;
+    std::vector<ReadRequest> reads;
+    std::vector<int> groupEvery; // per ReadRequest::group, polled every this many slots; empty: every slot
+    int frameWords;
+    int window;
+};
+
+enum SessionState
+{
+    SESSION_IDLE,       // waiting for the next poll
+    SESSION_CONNECTING, // a poll is due but waits for a connection
+    SESSION_READING     // requests of one cycle in flight on the active link
+};
+
+// What a failure means for the connection it happened on
+enum FailureClass
+{
+    FAIL_EXCEPTION,  // the PLC answered with a Modbus exception: connection kept, sample missed
+    FAIL_TIMEOUT,    // no connect or reply in time: connection dropped
+    FAIL_CONNECTION, // refused, reset, unreachable: connection dropped
+    FAIL_PROTOCOL,   // reply that cannot be ours: connection dropped
+    FAIL_CONFIG      // bad address: retried at the longest backoff
+};
+
+FailureClass classifyFailure(int err);
+
+struct ModbusSession;
+
+// One TCP connection of a session, to its PLC or to the standby. Down links
+// reconnect on their own, after a backoff, whether a poll is due or not.
+struct ModbusLink
+{
+    ModbusSession *session;
+    std::string ip;
+    int port;
+    int fd;           // -1 when down
+    bool connecting;
+    int64_t deadline; // monotonic ns, connect timeout
+    int64_t retryAt;  // monotonic ns, no connect before
+    int backoffMs;    // delay before the next retry, 0 after a success
+    uint64_t failures; // since it was last up
+    int lastError;
+};
+
+// One PLC, its links and its poll state machine. Sessions belong to exactly
+// one engine thread and are only touched there. Polls run on the active
+// link; when it fails the cycle is restarted on the standby link if that is
+// up, otherwise the sample is reported missed. Each slot starts on the
+// primary again when it is up.
+struct ModbusSession
+{
+    int id;
+    ModbusDevice dev;
+    ModbusLink links[2];
+    int nLinks;
+    int active; // link polls go to
+    SessionState state;
+    PollSchedule schedule;
+    int64_t deadline;   // monotonic ns, reply timeout
+    int64_t slotStart;  // wall clock ms the slot came due, stamped on a missed sample
+    int64_t cycleStart; // wall clock ms the first request went out, stamped on the frame
+    int64_t cycleStartNs; // the same in monotonic ns, for timing the cycle
+    bool failedOver;    // the cycle already moved to the other link once
+    int cycleError;     // exception a reply of this cycle carried, 0 if none
+    uint16_t base;
+    uint64_t slot;         // index of the slot being polled, skipped ones included
+    uint64_t polledGroups; // poll groups read since the last frame handed on
+    std::vector<int> due;  // their reads, indexes into dev.reads
+    int dueCount;
+    int sent;              // of due
+    int done;
+    std::vector<uint8_t> pending;
+    uint8_t tx[MBAP_READ_REQUEST_LENGTH];
+    int txLen;
+    int txOff;
+    bool wantWrite;
+    uint8_t rx[4 * MODBUS_TCP_MAX_ADU_LENGTH];
+    int fill;
+    std::vector<uint16_t> frame;
+    uint64_t changedReads; // bit min(i, 63): reads[i] differs from the last frame handed on
+    uint64_t cycles;
+    std::atomic<uint64_t> missed{0};
+    std::atomic<uint64_t> failovers{0};
+    uint64_t allocMark;   // thread allocations when the cycle started
+    uint64_t allocCycles; // steady-state cycles that touched the heap
+};
+
+// Called on the engine thread that owns the session, once per complete frame;
+// `frame` is only valid during the call, s.polledGroups tells which poll
+// groups were read and s.changedReads which reads brought new register values
+// since the last frame, missed cycles included (all of them on the first
+// frame). Registers of groups not polled hold what they were last read as.
+typedef std::function<void(const ModbusSession &s, const uint16_t *frame, int64_t millis)> FrameHandler;
+
+// Called instead when a due poll produced no frame, with why (errno or a
+// libmodbus error)
+typedef std::function<void(const ModbusSession &s, int64_t millis, int err)> MissedHandler;
+
+// One engine thread: its epoll set and the sessions it owns
+struct EngineWorker
+{
+    int epfd;
+    int timerfd; // armed at the next poll slot or timeout, whichever is first
+    std::vector<ModbusSession *> sessions;
+    std::thread thread;
+};
+
+// Drives every session from a fixed set of threads, each with its own epoll
+// set; sessions are spread over the threads round robin
+struct ModbusEngine
+{
+    int periodMs = DEFAULT_POLL_PERIOD_MS;
+    OverrunPolicy overrun = OVERRUN_SKIP;
+    int responseTimeoutMs = DEFAULT_RESPONSE_TIMEOUT_MS;
+    int connectTimeoutMs = DEFAULT_CONNECT_TIMEOUT_MS;
+    int reconnectMinMs = DEFAULT_RECONNECT_MIN_MS;
+    int reconnectMaxMs = DEFAULT_RECONNECT_MAX_MS;
+    FrameHandler onFrame;
+    MissedHandler onMissed;
+    std::vector<std::unique_ptr<ModbusSession>> sessions;
+    std::vector<std::unique_ptr<EngineWorker>> workers;
+    std::atomic<bool> running{false};
+
+    ~ModbusEngine();
+};
+
+// Returns the session id; only valid before engineStart
+int engineAddSession(ModbusEngine &engine, const ModbusDevice &dev);
+
+void engineStart(ModbusEngine &engine, int threads);
+
+void engineStop(ModbusEngine &engine);
+
+// Prints each session's poll count, missed samples, failovers, overruns,
+// skipped slots and how late its cycles started, mean and worst since the
+// last report
+void engineReport(ModbusEngine &engine);
+
+#endif // MODBUS_ENGINE_H
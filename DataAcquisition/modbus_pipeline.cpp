@@ -0,0 +1,67 @@
+#include <errno.h>
+#include "modbus_pipeline.h"
+
+#define FC_READ_HOLDING_REGISTERS 0x03
+
+static void putU16(uint8_t *p, int v)
+{
+    p[0] = (uint8_t)(v >> 8);
+    p[1] = (uint8_t)v;
+}
+
+void encodeReadRequest(uint8_t *frame, uint16_t tid, int slave, const ReadRequest &r)
+{
+    putU16(frame, tid);
+    putU16(frame + 2, 0); // protocol
+    putU16(frame + 4, 6); // unit + PDU
+    frame[6] = (uint8_t)slave;
+    frame[7] = FC_READ_HOLDING_REGISTERS;
+    putU16(frame + 8, r.addr);
+    putU16(frame + 10, r.nb);
+}
+
+int mbapFrameLength(const uint8_t *buf, int len)
+{
+    if (len < MBAP_HEADER_LENGTH)
+    {
+        return 0;
+    }
+    int protocol = (buf[2] << 8) | buf[3];
+    int length = (buf[4] << 8) | buf[5];
+    if (protocol != 0 || length < 3 || 6 + length > MODBUS_TCP_MAX_ADU_LENGTH)
+    {
+        return -1;
+    }
+    return len < 6 + length ? 0 : 6 + length;
+}
+
+int decodeReadReply(const uint8_t *frame, int len, int slave, const ReadRequest &r, uint16_t *dst)
+{
+    if (frame[6] != slave)
+    {
+        errno = EMBBADSLAVE;
+        return -1;
+    }
+    int function = frame[7];
+    if (function == (FC_READ_HOLDING_REGISTERS | 0x80))
+    {
+        errno = MODBUS_ENOBASE + frame[8];
+        return -1;
+    }
+    int bytes = frame[8];
+    if (function != FC_READ_HOLDING_REGISTERS || bytes != 2 * r.nb || len != 9 + bytes)
+    {
+        errno = EMBBADDATA;
+        return -1;
+    }
+
+    const uint8_t *p = frame + 9;
+    uint16_t diff = 0;
+    for (int i = 0; i < r.nb; ++i)
+    {
+        uint16_t v = (uint16_t)((p[2 * i] << 8) | p[2 * i + 1]);
+        diff |= dst[r.addr + i] ^ v;
+        dst[r.addr + i] = v;
+    }
+    return diff != 0;
+}
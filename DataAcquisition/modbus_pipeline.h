@@ -0,0 +1,34 @@
+#ifndef MODBUS_PIPELINE_H
+#define MODBUS_PIPELINE_H
+
+#include <stdint.h>
+#include <vector>
+#include "modbus.h"
+#include "modbus_read.h"
+
+// Transactions in flight per connection. 1 sends each request after the
+// previous reply, for PLCs that serve one transaction at a time.
+#define DEFAULT_MODBUS_WINDOW 1
+
+// MBAP header (7 bytes) + function code + start address + quantity
+#define MBAP_READ_REQUEST_LENGTH 12
+#define MBAP_HEADER_LENGTH 7
+
+// Read holding registers (0x03) request for `r`, tagged with transaction `tid`
+void encodeReadRequest(uint8_t *frame, uint16_t tid, int slave, const ReadRequest &r);
+
+// Size of the complete ADU at the front of `buf`, 0 while bytes are still
+// missing, -1 if the header cannot belong to a Modbus TCP reply
+int mbapFrameLength(const uint8_t *buf, int len);
+
+static inline uint16_t mbapTransactionId(const uint8_t *frame)
+{
+    return (uint16_t)((frame[0] << 8) | frame[1]);
+}
+
+// Checks a reply to `r` and stores its registers at dst + r.addr. Returns 1 if
+// any of them differs from what dst held, 0 if none does, -1 with errno set
+// (MODBUS_ENOBASE + code for exception replies) when the reply is bad.
+int decodeReadReply(const uint8_t *frame, int len, int slave, const ReadRequest &r, uint16_t *dst);
+
+#endif // MODBUS_PIPELINE_H
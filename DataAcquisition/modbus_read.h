@@ -1,12 +1,21 @@
 #ifndef MODBUS_READ_H
 #define MODBUS_READ_H
 
-void modbusConn(const char *ip, int port, int slave_id);
+#include <vector>
+#include "register_map.h"
 
-uint16_t *read_registers(int start_registers, int nb_registers);
+#define DEFAULT_READ_GAP 125
 
-float *extractAnalog(const uint16_t *c);
+// One Modbus read: `nb` holding registers starting at `addr`
+struct ReadRequest
+{
+    int addr;
+    int nb;
+    int group; // poll group of the device (see Device::groupEvery), 0 if it has one
+};
 
-uint8_t *extractBool(const uint16_t *c);
+std::vector<ReadRequest> planReads(const DecodePlan &plan, int gap);
+
+void printReadPlan(const std::vector<ReadRequest> &requests, const DecodePlan &plan);
 
 #endif // MODBUS_READ_H
\ No newline at end of file
@@ -0,0 +1,328 @@
+// Modbus TCP PLC simulator: serves the holding registers of a register map
+// to any number of clients, for testing and benchmarking without a PLC.
+//
+//   ./modbus_sim [-p port] [-m register_map.json] [-r frames.bin] [-s slaves]
+//                [-l latency_ms] [-j jitter_ms] [-d drop] [-u update_ms]
+//
+// Every unit id from 1 to `slaves` has its own register image with the map's
+// layout. Without -r the images are synthetic: each decoded value starts at a
+// random plausible value and a few of them move every `update_ms`, like a
+// PLC scan. With -r they play back frames.bin (bench_decode's format, one
+// frame every `update_ms`, looping), slave k starting k frames in. Each
+// request is answered after `latency_ms` plus up to +-`jitter_ms`, and not at
+// all with probability `drop`, which the client sees as a timeout. Each
+// connection is served by its own thread, requests in order.
+#include <math.h>
+#include <signal.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+#include "modbus.h"
+#include "register_map.h"
+#include "easylogging++.h"
+
+INITIALIZE_EASYLOGGINGPP
+
+#define SIM_DEFAULT_PORT 1502
+#define SIM_DEFAULT_UPDATE_MS 100
+// Share of decoded values a synthetic scan changes
+#define SIM_CHANGE_FRACTION 0.05
+#define SIM_REPORT_S 10
+
+struct SimConfig
+{
+    int port = SIM_DEFAULT_PORT;
+    const char *registerMap = DEFAULT_REGISTER_MAP;
+    const char *frames = NULL;
+    int slaves = 1;
+    double latencyMs = 0;
+    double jitterMs = 0;
+    double drop = 0;
+    int updateMs = SIM_DEFAULT_UPDATE_MS;
+};
+
+// One simulated PLC; `values` are the engineering values of the map's analog
+// entries, encoded into `regs` whenever they change
+struct SimSlave
+{
+    modbus_mapping_t *regs;
+    std::vector<double> values;
+    size_t frame;
+};
+
+static std::mutex imageLock; // guards every slave's registers
+static std::atomic<uint64_t> served{0};
+static std::atomic<uint64_t> dropped{0};
+static std::atomic<int> connections{0};
+
+static uint16_t swapBytes(uint16_t w)
+{
+    return (uint16_t)(w << 8 | w >> 8);
+}
+
+// The inverse of decodeAnalog for one entry: value / scale in the entry's
+// type, word and byte order
+static void encodeAnalog(const RegisterEntry &e, double value, uint16_t *regs)
+{
+    double raw = e.scale != 0 ? value / e.scale : value;
+    uint32_t bits = 0;
+    switch (e.type)
+    {
+    case REG_UINT16:
+        bits = (uint16_t)std::min(std::max(lround(raw), 0L), 65535L);
+        break;
+    case REG_INT16:
+        bits = (uint16_t)(int16_t)std::min(std::max(lround(raw), -32768L), 32767L);
+        break;
+    case REG_UINT32:
+        bits = (uint32_t)std::max(llround(raw), 0LL);
+        break;
+    case REG_INT32:
+        bits = (uint32_t)(int32_t)llround(raw);
+        break;
+    case REG_FLOAT32:
+    {
+        float f = (float)raw;
+        memcpy(&bits, &f, sizeof(bits));
+        break;
+    }
+    default:
+        return;
+    }
+    uint16_t hi = e.words == 2 ? (uint16_t)(bits >> 16) : (uint16_t)bits;
+    uint16_t lo = (uint16_t)bits;
+    if (e.byteSwap)
+    {
+        hi = swapBytes(hi);
+        lo = swapBytes(lo);
+    }
+    if (e.words == 1)
+    {
+        regs[e.addr] = hi;
+        return;
+    }
+    regs[e.addr] = e.wordSwap ? lo : hi;
+    regs[e.addr + 1] = e.wordSwap ? hi : lo;
+}
+
+// A value in the range its type and scale can hold, kept small so 16-bit
+// registers have room to move
+static double plausible(const RegisterEntry &e, std::mt19937 &rng)
+{
+    double span = e.type == REG_UINT16 || e.type == REG_UINT32 ? 1000 : 500;
+    double raw = std::uniform_real_distribution<double>(e.type == REG_UINT16 || e.type == REG_UINT32 ? 0 : -span, span)(rng);
+    return e.type == REG_FLOAT32 ? raw : raw * e.scale;
+}
+
+// One synthetic PLC scan: a few values take a small step, a few bool words
+// flip a bit
+static void scanSynthetic(const RegisterMap &map, SimSlave &s, std::mt19937 &rng)
+{
+    std::uniform_real_distribution<double> pick(0, 1);
+    std::normal_distribution<double> step(0, 1);
+    for (size_t i = 0; i < map.analogs.size(); ++i)
+    {
+        const RegisterEntry &e = map.analogs[i];
+        if (pick(rng) < SIM_CHANGE_FRACTION)
+        {
+            double unit = e.type == REG_FLOAT32 || e.scale == 0 ? 1 : e.scale;
+            s.values[i] = std::max(s.values[i] + step(rng) * 5 * unit, e.type == REG_UINT16 || e.type == REG_UINT32 ? 0.0 : -1e9);
+            encodeAnalog(e, s.values[i], s.regs->tab_registers);
+        }
+    }
+    for (const RegisterEntry &e : map.bools)
+    {
+        if (pick(rng) < SIM_CHANGE_FRACTION)
+        {
+            s.regs->tab_registers[e.addr] ^= (uint16_t)(1u << (rng() % 16));
+        }
+    }
+}
+
+static std::vector<uint16_t> loadFrames(const char *path, int frameWords)
+{
+    std::ifstream in(path, std::ios::binary);
+    std::vector<uint16_t> frames;
+    if (!in)
+    {
+        return frames;
+    }
+    in.seekg(0, std::ios::end);
+    size_t count = (size_t)in.tellg() / (frameWords * sizeof(uint16_t));
+    in.seekg(0);
+    frames.resize(count * frameWords);
+    in.read((char *)frames.data(), frames.size() * sizeof(uint16_t));
+    return frames;
+}
+
+static void serve(modbus_t *conn, std::vector<SimSlave> &slaves, const SimConfig &cfg, unsigned seed)
+{
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<double> pick(0, 1);
+    std::uniform_real_distribution<double> jitter(-cfg.jitterMs, cfg.jitterMs);
+    uint8_t req[MODBUS_TCP_MAX_ADU_LENGTH];
+    int header = modbus_get_header_length(conn);
+    ++connections;
+    while (1)
+    {
+        int len = modbus_receive(conn, req);
+        if (len == 0)
+        {
+            continue; // not for us
+        }
+        if (len == -1)
+        {
+            break;
+        }
+        if (cfg.drop > 0 && pick(rng) < cfg.drop)
+        {
+            ++dropped;
+            continue;
+        }
+        double delayMs = std::max(0.0, cfg.latencyMs + (cfg.jitterMs > 0 ? jitter(rng) : 0));
+        if (delayMs > 0)
+        {
+            std::this_thread::sleep_for(std::chrono::microseconds((int64_t)(delayMs * 1000)));
+        }
+        int unit = req[header - 1];
+        if (unit < 1 || unit > (int)slaves.size())
+        {
+            modbus_reply_exception(conn, req, MODBUS_EXCEPTION_GATEWAY_TARGET);
+            continue;
+        }
+        std::lock_guard<std::mutex> hold(imageLock);
+        modbus_reply(conn, req, len, slaves[unit - 1].regs);
+        ++served;
+    }
+    --connections;
+    modbus_close(conn);
+    modbus_free(conn);
+}
+
+static void usage()
+{
+    puts("usage: modbus_sim [-p port] [-m register_map.json] [-r frames.bin] [-s slaves] [-l latency_ms] [-j jitter_ms] [-d drop] [-u update_ms]");
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, char *argv[])
+{
+    SimConfig cfg;
+    int opt;
+    while ((opt = getopt(argc, argv, "p:m:r:s:l:j:d:u:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'p': cfg.port = atoi(optarg); break;
+        case 'm': cfg.registerMap = optarg; break;
+        case 'r': cfg.frames = optarg; break;
+        case 's': cfg.slaves = std::max(1, std::min(atoi(optarg), 247)); break;
+        case 'l': cfg.latencyMs = atof(optarg); break;
+        case 'j': cfg.jitterMs = atof(optarg); break;
+        case 'd': cfg.drop = atof(optarg); break;
+        case 'u': cfg.updateMs = std::max(1, atoi(optarg)); break;
+        default: usage();
+        }
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    RegisterMap map = loadRegisterMap(cfg.registerMap);
+    DecodePlan plan = compileDecodePlan(map);
+    std::vector<uint16_t> frames;
+    size_t frameCount = 0;
+    if (cfg.frames != NULL)
+    {
+        frames = loadFrames(cfg.frames, plan.maxAddr + 1);
+        frameCount = frames.size() / (plan.maxAddr + 1);
+        if (frameCount == 0)
+        {
+            printf("No frames of %d words in %s\n", plan.maxAddr + 1, cfg.frames);
+            return EXIT_FAILURE;
+        }
+    }
+
+    std::mt19937 rng(1);
+    std::vector<SimSlave> slaves(cfg.slaves);
+    for (size_t k = 0; k < slaves.size(); ++k)
+    {
+        SimSlave &s = slaves[k];
+        s.regs = modbus_mapping_new(0, 0, plan.frameWords, 0);
+        s.frame = k;
+        for (const RegisterEntry &e : map.analogs)
+        {
+            s.values.push_back(plausible(e, rng));
+            encodeAnalog(e, s.values.back(), s.regs->tab_registers);
+        }
+        for (const RegisterEntry &e : map.bools)
+        {
+            s.regs->tab_registers[e.addr] = (uint16_t)rng();
+        }
+    }
+
+    // The PLC scan: every image moves on once per update_ms
+    std::thread([&] {
+        auto next = std::chrono::steady_clock::now();
+        while (1)
+        {
+            next += std::chrono::milliseconds(cfg.updateMs);
+            std::this_thread::sleep_until(next);
+            std::lock_guard<std::mutex> hold(imageLock);
+            for (SimSlave &s : slaves)
+            {
+                if (frameCount > 0)
+                {
+                    s.frame = (s.frame + 1) % frameCount;
+                    memcpy(s.regs->tab_registers, &frames[s.frame * (plan.maxAddr + 1)], (plan.maxAddr + 1) * sizeof(uint16_t));
+                }
+                else
+                {
+                    scanSynthetic(map, s, rng);
+                }
+            }
+        }
+    }).detach();
+
+    std::thread([] {
+        uint64_t last = 0;
+        while (1)
+        {
+            std::this_thread::sleep_for(std::chrono::seconds(SIM_REPORT_S));
+            uint64_t now = served.load();
+            printf("%d connections, %.0f requests/s, %lu dropped\n", connections.load(), (double)(now - last) / SIM_REPORT_S,
+                   (unsigned long)dropped.load());
+            fflush(stdout);
+            last = now;
+        }
+    }).detach();
+
+    modbus_t *server = modbus_new_tcp("0.0.0.0", cfg.port);
+    int listener = modbus_tcp_listen(server, 64);
+    if (listener == -1)
+    {
+        printf("Failed to listen on port %d: %s\n", cfg.port, modbus_strerror(errno));
+        return EXIT_FAILURE;
+    }
+    printf("Simulating %d slaves of %s (%d registers, %s) on port %d, latency %.1f +- %.1f ms, %.1f%% dropped\n",
+           cfg.slaves, cfg.registerMap, plan.frameWords, frameCount > 0 ? "recorded" : "synthetic", cfg.port, cfg.latencyMs,
+           cfg.jitterMs, cfg.drop * 100);
+    fflush(stdout);
+    unsigned seed = 1;
+    while (1)
+    {
+        int s = modbus_tcp_accept(server, &listener);
+        if (s == -1)
+        {
+            continue;
+        }
+        modbus_t *conn = modbus_new_tcp("0.0.0.0", cfg.port);
+        modbus_set_socket(conn, s);
+        std::thread(serve, conn, std::ref(slaves), std::cref(cfg), ++seed).detach();
+    }
+}
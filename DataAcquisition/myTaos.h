@@ -1,14 +1,21 @@
 #ifndef MYTAOS_H
 #define MYTAOS_H
 
-void taosConn(const char *ip, const char *username, const char *password, const char *database, uint16_t port);
+// A connection of its own, e.g. for a writer thread
+TAOS *taosConnect(const char *ip, const char *username, const char *password, const char *database, uint16_t port);
 
-void executeSQL(const char *sql);
+// Same, but NULL instead of exiting when the server is unreachable
+TAOS *taosTryConnect(const char *ip, const char *username, const char *password, const char *database, uint16_t port);
 
-void checkErrorCode(TAOS_STMT *stmt, int code, const char *msg);
+// True for TDengine error codes (taoserror.h) meaning the server could not be
+// reached or the connection broke. Any other failure is TDengine refusing the
+// statement or its rows, which a retry would only repeat.
+bool taosUnreachable(int code);
 
-void create_stable(int len, const char *tn, const char *type);
+// Logs a failed statement call and returns false instead of exiting
+bool stmtOk(TAOS_STMT *stmt, int code, const char *msg);
 
-char *myQuery();
+// Same for a query or schemaless insert; frees `res`
+bool resultOk(TAOS_RES *res, const char *msg);
 
 #endif // MYTAOS_H
\ No newline at end of file
@@ -0,0 +1,55 @@
+#include <errno.h>
+#include <time.h>
+#include "poll_schedule.h"
+
+int64_t monotonicNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+void scheduleStart(PollSchedule &s, int64_t first, int64_t periodNs, OverrunPolicy policy)
+{
+    s.periodNs = periodNs;
+    s.first = first;
+    s.next = first;
+    s.policy = policy;
+}
+
+int64_t scheduleFire(PollSchedule &s, int64_t now)
+{
+    int64_t late = now - s.next;
+    s.slots.fetch_add(1, std::memory_order_relaxed);
+    s.lateSumNs.fetch_add(late, std::memory_order_relaxed);
+    if (late > s.lateMaxNs.load(std::memory_order_relaxed))
+    {
+        s.lateMaxNs.store(late, std::memory_order_relaxed);
+    }
+
+    s.next += s.periodNs;
+    if (s.next > now)
+    {
+        return 0;
+    }
+    s.overruns.fetch_add(1, std::memory_order_relaxed);
+    int64_t missed = (now - s.next) / s.periodNs + 1;
+    if (s.policy == OVERRUN_CATCH_UP && missed <= SCHEDULE_MAX_CATCH_UP)
+    {
+        return 0; // s.next is already due, the caller polls again right away
+    }
+    // Stay on the grid: the first slot after now, not now + period
+    s.next += missed * s.periodNs;
+    s.skipped.fetch_add(missed, std::memory_order_relaxed);
+    return missed;
+}
+
+void sleepUntil(int64_t deadline)
+{
+    struct timespec ts;
+    ts.tv_sec = deadline / 1000000000;
+    ts.tv_nsec = deadline % 1000000000;
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+    {
+    }
+}
@@ -0,0 +1,53 @@
+#ifndef POLL_SCHEDULE_H
+#define POLL_SCHEDULE_H
+
+#include <stdint.h>
+#include <atomic>
+
+// A slot that comes due this many periods late is not caught up but skipped,
+// e.g. after the PLC was unreachable for a while
+#define SCHEDULE_MAX_CATCH_UP 16
+
+// What to do with slots that passed while a cycle overran
+enum OverrunPolicy
+{
+    OVERRUN_SKIP,    // drop them and carry on with the next slot still ahead
+    OVERRUN_CATCH_UP // poll once for each of them, back to back
+};
+
+// Fixed-rate slots on CLOCK_MONOTONIC: slot k is due at start + k * period,
+// so late wake-ups and long cycles never shift the ones after them.
+// Counters are written by the owning thread and read by anyone.
+struct PollSchedule
+{
+    int64_t periodNs;
+    int64_t first; // monotonic ns slot 0 was due
+    int64_t next;  // monotonic ns the next slot is due
+    OverrunPolicy policy;
+    std::atomic<uint64_t> slots{0};      // slots started
+    std::atomic<uint64_t> overruns{0};   // slots that came due more than a period late
+    std::atomic<uint64_t> skipped{0};    // slots dropped
+    std::atomic<int64_t> lateSumNs{0};   // start minus due, summed over slots
+    std::atomic<int64_t> lateMaxNs{0};   // the same, worst since it was last taken
+};
+
+int64_t monotonicNs();
+
+void scheduleStart(PollSchedule &s, int64_t first, int64_t periodNs, OverrunPolicy policy);
+
+// Starts the slot due at s.next at `now` >= s.next: records how late it is
+// and moves s.next on according to the policy. Returns how many slots after
+// it were skipped, the ones just before the new s.next.
+int64_t scheduleFire(PollSchedule &s, int64_t now);
+
+// Index of the slot due at s.next, counting the skipped ones too
+inline uint64_t scheduleSlot(const PollSchedule &s)
+{
+    return (uint64_t)((s.next - s.first) / s.periodNs);
+}
+
+// Sleeps until monotonic `deadline` ns with clock_nanosleep(TIMER_ABSTIME),
+// so the time spent before the call does not add up
+void sleepUntil(int64_t deadline);
+
+#endif // POLL_SCHEDULE_H
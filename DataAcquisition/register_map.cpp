@@ -0,0 +1,512 @@
+#include <fstream>
+#include <string.h>
+#include <json.hpp>
+#include "register_map.h"
+#include "bit_unpack.h"
+#include "analog_convert.h"
+#include "easylogging++.h"
+
+using json = nlohmann::json;
+
+static void mapError(const char *path, const std::string &msg)
+{
+    printf("Register map %s: %s\n", path, msg.c_str());
+    LOG(ERROR) << "Register map " << path << ": " << msg;
+    exit(EXIT_FAILURE);
+}
+
+static bool parseType(const std::string &name, RegType &type)
+{
+    static const std::unordered_map<std::string, RegType> types = {
+        {"UINT16", REG_UINT16},
+        {"INT16", REG_INT16},
+        {"UINT32", REG_UINT32},
+        {"INT32", REG_INT32},
+        {"FLOAT32", REG_FLOAT32},
+        {"BOOL16", REG_BOOL16}
+    };
+    auto iter = types.find(name);
+    if (iter == types.end())
+    {
+        return false;
+    }
+    type = iter->second;
+    return true;
+}
+
+// Byte order letters follow libmodbus: A is the most significant byte
+static bool parseOrder(const std::string &order, int words, bool &wordSwap, bool &byteSwap)
+{
+    if (words == 1)
+    {
+        wordSwap = false;
+        if (order == "AB")
+        {
+            byteSwap = false;
+            return true;
+        }
+        if (order == "BA")
+        {
+            byteSwap = true;
+            return true;
+        }
+        return false;
+    }
+
+    if (order == "ABCD") { wordSwap = false; byteSwap = false; return true; }
+    if (order == "BADC") { wordSwap = false; byteSwap = true;  return true; }
+    if (order == "CDAB") { wordSwap = true;  byteSwap = false; return true; }
+    if (order == "DCBA") { wordSwap = true;  byteSwap = true;  return true; }
+    return false;
+}
+
+// Analog lines with "deadband" and/or "deadband_pct", and bool lines with
+// "on_change": true, are stored on change; top-level keys of the same names
+// apply to every line, and "heartbeat" (seconds) bounds the silence
+static Deadband parseDeadband(const char *path, const json &item, const json &defaults, bool isBool)
+{
+    Deadband band{};
+    if (isBool)
+    {
+        band.enabled = item.value("on_change", defaults.value("on_change", false));
+    }
+    else
+    {
+        band.abs = item.value("deadband", defaults.value("deadband", 0.0f));
+        band.pct = item.value("deadband_pct", defaults.value("deadband_pct", 0.0f));
+        band.enabled = item.contains("deadband") || item.contains("deadband_pct") ||
+                       defaults.contains("deadband") || defaults.contains("deadband_pct");
+    }
+    float heartbeat = item.value("heartbeat", defaults.value("heartbeat", (float)DEFAULT_HEARTBEAT_S));
+    if (band.abs < 0 || band.pct < 0 || heartbeat < 0)
+    {
+        mapError(path, "negative deadband or heartbeat in " + item.dump());
+    }
+    band.heartbeatMs = (int32_t)(heartbeat * 1000);
+    return band;
+}
+
+// Expands `{"addr", "type", "count", "stride", "order", "scale", "col"}` lines;
+// "col" defaults to the column following the previous line. "period_ms", on
+// a line or top level, polls the line that often instead of every poll.
+static void parseSection(const char *path, const json &section, const json &defaults, bool isBool, std::vector<RegisterEntry> &out)
+{
+    if (!section.is_array())
+    {
+        mapError(path, isBool ? "\"bool\" must be an array" : "\"analog\" must be an array");
+    }
+
+    int nextCol = 0;
+    for (const json &item : section)
+    {
+        if (!item.contains("addr") || !item.contains("type"))
+        {
+            mapError(path, "entry without addr or type: " + item.dump());
+        }
+
+        RegType type;
+        if (!parseType(item["type"].get<std::string>(), type))
+        {
+            mapError(path, "unknown type in " + item.dump());
+        }
+        if ((type == REG_BOOL16) != isBool)
+        {
+            mapError(path, isBool ? "only BOOL16 belongs in \"bool\": " + item.dump()
+                                  : "BOOL16 belongs in \"bool\": " + item.dump());
+        }
+
+        int words = (type == REG_UINT32 || type == REG_INT32 || type == REG_FLOAT32) ? 2 : 1;
+        if (item.value("words", words) != words)
+        {
+            mapError(path, "word count does not match type in " + item.dump());
+        }
+
+        bool wordSwap, byteSwap;
+        std::string order = item.value("order", std::string(words == 2 ? "ABCD" : "AB"));
+        if (!parseOrder(order, words, wordSwap, byteSwap))
+        {
+            mapError(path, "bad byte order in " + item.dump());
+        }
+
+        int addr = item["addr"];
+        int count = item.value("count", 1);
+        int stride = item.value("stride", words);
+        float scale = item.value("scale", 1.0f);
+        int col = item.value("col", nextCol);
+        int width = isBool ? 16 : 1;
+        int periodMs = item.value("period_ms", defaults.value("period_ms", 0));
+        if (addr < 0 || count < 1 || stride < 1 || col < 0 || periodMs < 0)
+        {
+            mapError(path, "bad addr, count, stride, col or period_ms in " + item.dump());
+        }
+        Deadband band = parseDeadband(path, item, defaults, isBool);
+
+        for (int k = 0; k < count; ++k)
+        {
+            RegisterEntry e;
+            e.addr = addr + k * stride;
+            e.words = words;
+            e.type = type;
+            e.wordSwap = wordSwap;
+            e.byteSwap = byteSwap;
+            e.scale = scale;
+            e.col = col + k * width;
+            e.band = band;
+            e.periodMs = periodMs;
+            out.push_back(e);
+        }
+        nextCol = col + count * width;
+    }
+}
+
+RegisterMap loadRegisterMap(const char *path)
+{
+    std::ifstream file(path);
+    if (!file.is_open())
+    {
+        mapError(path, "failed to open");
+    }
+
+    json doc;
+    try
+    {
+        file >> doc;
+    }
+    catch (const json::exception &e)
+    {
+        mapError(path, e.what());
+    }
+
+    RegisterMap map;
+    parseSection(path, doc.value("analog", json::array()), doc, false, map.analogs);
+    parseSection(path, doc.value("bool", json::array()), doc, true, map.bools);
+    return map;
+}
+
+// Output columns must be dense: every column in [0, cols) written exactly once.
+// A span of `width` columns starts at a multiple of it, so a BOOL16 entry is
+// exactly one word of packed storage (packBool).
+static int checkColumns(const std::vector<RegisterEntry> &entries, int width, const char *kind)
+{
+    int cols = (int)entries.size() * width;
+    std::vector<uint8_t> seen(cols, 0);
+    for (const RegisterEntry &e : entries)
+    {
+        if (e.col % width != 0)
+        {
+            printf("Register map: %s column %d is not a multiple of %d\n", kind, e.col, width);
+            LOG(ERROR) << "Register map: " << kind << " column " << e.col << " is not a multiple of " << width;
+            exit(EXIT_FAILURE);
+        }
+        for (int b = 0; b < width; ++b)
+        {
+            if (e.col + b >= cols || seen[e.col + b]++)
+            {
+                printf("Register map: %s column %d is out of range or duplicated\n", kind, e.col + b);
+                LOG(ERROR) << "Register map: " << kind << " column " << e.col + b << " is out of range or duplicated";
+                exit(EXIT_FAILURE);
+            }
+        }
+    }
+    return cols;
+}
+
+static Op16Group &groupFor(std::vector<Op16Group> &groups, const RegisterEntry &e)
+{
+    bool scaled = e.scale != 1.0f;
+    for (Op16Group &g : groups)
+    {
+        if (g.type == e.type && g.byteSwap == e.byteSwap && g.scaled == scaled)
+        {
+            return g;
+        }
+    }
+    Op16Group g{};
+    g.type = e.type;
+    g.byteSwap = e.byteSwap;
+    g.scaled = scaled;
+    groups.push_back(g);
+    return groups.back();
+}
+
+static Op32Group &groupFor(std::vector<Op32Group> &groups, const RegisterEntry &e)
+{
+    bool scaled = e.scale != 1.0f;
+    for (Op32Group &g : groups)
+    {
+        if (g.type == e.type && g.wordSwap == e.wordSwap && g.byteSwap == e.byteSwap && g.scaled == scaled)
+        {
+            return g;
+        }
+    }
+    Op32Group g{};
+    g.type = e.type;
+    g.wordSwap = e.wordSwap;
+    g.byteSwap = e.byteSwap;
+    g.scaled = scaled;
+    groups.push_back(g);
+    return groups.back();
+}
+
+// Extends the group's last run when `e` continues it at a constant stride
+// into the next column, otherwise starts a new run
+template <typename G>
+static void addToRun(G &g, const RegisterEntry &e)
+{
+    int32_t index = (int32_t)g.scale.size();
+    if (!g.runs.empty())
+    {
+        DecodeRun &last = g.runs.back();
+        int32_t stride = last.count == 1 ? e.addr - last.addr : last.stride;
+        if (stride > 0 && e.addr == last.addr + last.count * stride && e.col == last.col + last.count)
+        {
+            last.stride = stride;
+            ++last.count;
+            g.scale.push_back(e.scale);
+            return;
+        }
+    }
+    g.runs.push_back({e.addr, e.words, e.col, 1, index});
+    g.scale.push_back(e.scale);
+}
+
+static DecodePlan compilePlan(const RegisterMap &map, int analogCols, int boolCols)
+{
+    DecodePlan plan{};
+    plan.analogCols = analogCols;
+    plan.boolCols = boolCols;
+    plan.minAddr = INT32_MAX;
+    plan.maxAddr = -1;
+
+    for (const RegisterEntry &e : map.analogs)
+    {
+        plan.minAddr = std::min(plan.minAddr, e.addr);
+        plan.maxAddr = std::max(plan.maxAddr, e.addr + e.words - 1);
+        if (e.words == 1)
+        {
+            addToRun(groupFor(plan.op16, e), e);
+        }
+        else
+        {
+            addToRun(groupFor(plan.op32, e), e);
+        }
+    }
+
+    // Unscaled groups skip the multiply, so their scale vectors go
+    for (Op16Group &g : plan.op16)
+    {
+        if (!g.scaled)
+        {
+            g.scale.clear();
+        }
+    }
+    for (Op32Group &g : plan.op32)
+    {
+        if (!g.scaled)
+        {
+            g.scale.clear();
+        }
+    }
+
+    for (const RegisterEntry &e : map.bools)
+    {
+        plan.minAddr = std::min(plan.minAddr, e.addr);
+        plan.maxAddr = std::max(plan.maxAddr, e.addr);
+        if (!plan.bools.empty())
+        {
+            BoolSpan &last = plan.bools.back();
+            if (last.addr + last.words == e.addr && last.col + last.words * 16 == e.col && last.byteSwap == e.byteSwap)
+            {
+                ++last.words;
+                continue;
+            }
+        }
+        plan.bools.push_back({e.addr, 1, e.col, e.byteSwap});
+    }
+
+    plan.analogBands.resize(plan.analogCols);
+    for (const RegisterEntry &e : map.analogs)
+    {
+        plan.analogBands[e.col] = e.band;
+    }
+    plan.boolBands.resize(plan.boolCols);
+    for (const RegisterEntry &e : map.bools)
+    {
+        std::fill(plan.boolBands.begin() + e.col, plan.boolBands.begin() + e.col + 16, e.band);
+    }
+
+    if (plan.maxAddr < 0)
+    {
+        plan.minAddr = 0;
+    }
+    plan.frameWords = plan.maxAddr + 1 + REGISTER_PAD_WORDS;
+    return plan;
+}
+
+DecodePlan compileDecodePlan(const RegisterMap &map)
+{
+    return compilePlan(map, checkColumns(map.analogs, 1, "analog"), checkColumns(map.bools, 16, "bool"));
+}
+
+DecodePlan compileRangePlan(const RegisterMap &map, const DecodePlan &full, int addr, int nb)
+{
+    RegisterMap part;
+    for (const RegisterEntry &e : map.analogs)
+    {
+        if (e.addr < addr + nb && e.addr + e.words > addr)
+        {
+            part.analogs.push_back(e);
+        }
+    }
+    for (const RegisterEntry &e : map.bools)
+    {
+        if (e.addr >= addr && e.addr < addr + nb)
+        {
+            part.bools.push_back(e);
+        }
+    }
+    DecodePlan plan = compilePlan(part, full.analogCols, full.boolCols);
+    plan.analogBands.clear();
+    plan.boolBands.clear();
+    return plan;
+}
+
+static const char *typeName(RegType type)
+{
+    switch (type)
+    {
+    case REG_UINT16: return "UINT16";
+    case REG_INT16: return "INT16";
+    case REG_UINT32: return "UINT32";
+    case REG_INT32: return "INT32";
+    case REG_FLOAT32: return "FLOAT32";
+    default: return "BOOL16";
+    }
+}
+
+void printDecodePlan(const DecodePlan &plan)
+{
+    printf("Decode plan: %d analog cols, %d bool cols, registers %d..%d, %s kernels\n",
+           plan.analogCols, plan.boolCols, plan.minAddr, plan.maxAddr, analogKernels().isa);
+    LOG(INFO) << "Decode plan: " << plan.analogCols << " analog cols, " << plan.boolCols
+              << " bool cols, registers " << plan.minAddr << ".." << plan.maxAddr;
+    for (const Op16Group &g : plan.op16)
+    {
+        printf("  %-7s %s%s: %zu runs\n", typeName(g.type), g.byteSwap ? "BA" : "AB", g.scaled ? " scaled" : "", g.runs.size());
+    }
+    for (const Op32Group &g : plan.op32)
+    {
+        static const char *orders[2][2] = {{"ABCD", "BADC"}, {"CDAB", "DCBA"}};
+        printf("  %-7s %s%s: %zu runs\n", typeName(g.type), orders[g.wordSwap][g.byteSwap], g.scaled ? " scaled" : "", g.runs.size());
+    }
+    printf("  BOOL16  %zu spans\n", plan.bools.size());
+
+    auto filtered = [](const std::vector<Deadband> &bands) {
+        return std::count_if(bands.begin(), bands.end(), [](const Deadband &b) { return b.enabled; });
+    };
+    long analogs = filtered(plan.analogBands);
+    long bools = filtered(plan.boolBands);
+    if (analogs + bools > 0)
+    {
+        printf("  stored on change: %ld analog cols, %ld bool cols\n", analogs, bools);
+        LOG(INFO) << "Stored on change: " << analogs << " analog cols, " << bools << " bool cols";
+    }
+}
+
+std::vector<int> decodedRegisters(const DecodePlan &plan)
+{
+    std::vector<uint8_t> used(plan.maxAddr + 1, 0);
+    for (const Op16Group &g : plan.op16)
+    {
+        for (const DecodeRun &r : g.runs)
+        {
+            for (int k = 0; k < r.count; ++k)
+            {
+                used[r.addr + k * r.stride] = 1;
+            }
+        }
+    }
+    for (const Op32Group &g : plan.op32)
+    {
+        for (const DecodeRun &r : g.runs)
+        {
+            for (int k = 0; k < r.count; ++k)
+            {
+                used[r.addr + k * r.stride] = 1;
+                used[r.addr + k * r.stride + 1] = 1;
+            }
+        }
+    }
+    for (const BoolSpan &s : plan.bools)
+    {
+        memset(&used[s.addr], 1, s.words);
+    }
+
+    std::vector<int> addrs;
+    for (int addr = 0; addr <= plan.maxAddr; ++addr)
+    {
+        if (used[addr])
+        {
+            addrs.push_back(addr);
+        }
+    }
+    return addrs;
+}
+
+void decodeAnalogWith(const DecodePlan &plan, const uint16_t *c, float *out, const AnalogKernels &kernels)
+{
+    for (const Op16Group &g : plan.op16)
+    {
+        ConvertFn fn = g.type == REG_INT16 ? kernels.i16[g.byteSwap] : kernels.u16[g.byteSwap];
+        for (const DecodeRun &r : g.runs)
+        {
+            fn(c, r.addr, r.stride, r.count, g.scaled ? &g.scale[r.first] : NULL, out + r.col);
+        }
+    }
+
+    for (const Op32Group &g : plan.op32)
+    {
+        const ConvertFn(*table)[2] = g.type == REG_FLOAT32 ? kernels.f32 : g.type == REG_INT32 ? kernels.i32 : kernels.u32;
+        ConvertFn fn = table[g.wordSwap][g.byteSwap];
+        for (const DecodeRun &r : g.runs)
+        {
+            fn(c, r.addr, r.stride, r.count, g.scaled ? &g.scale[r.first] : NULL, out + r.col);
+        }
+    }
+}
+
+void decodeAnalog(const DecodePlan &plan, const uint16_t *c, float *out)
+{
+    decodeAnalogWith(plan, c, out, analogKernels());
+}
+
+void decodeBool(const DecodePlan &plan, const uint16_t *c, uint8_t *out)
+{
+    for (const BoolSpan &s : plan.bools)
+    {
+        unpackBits(c + s.addr, s.words, s.byteSwap, out + s.col);
+    }
+}
+
+void decodeRaw(const DecodePlan &plan, const uint16_t *c, uint16_t *out)
+{
+    for (const Op16Group &g : plan.op16)
+    {
+        for (const DecodeRun &r : g.runs)
+        {
+            const uint16_t *src = c + r.addr;
+            for (int i = 0; i < r.count; ++i, src += r.stride)
+            {
+                out[r.col + i] = g.byteSwap ? (uint16_t)((*src >> 8) | (*src << 8)) : *src;
+            }
+        }
+    }
+}
+
+void packBool(const DecodePlan &plan, const uint16_t *c, uint16_t *out)
+{
+    for (const BoolSpan &s : plan.bools)
+    {
+        packBits(c + s.addr, s.words, s.byteSwap, out + s.col / 16);
+    }
+}
@@ -0,0 +1,139 @@
+#ifndef REGISTER_MAP_H
+#define REGISTER_MAP_H
+
+#include <stdint.h>
+#include <vector>
+
+struct AnalogKernels;
+
+#define DEFAULT_REGISTER_MAP "register_map.json"
+// Longest a filtered column goes without a stored value, unless the map says
+#define DEFAULT_HEARTBEAT_S 60
+
+enum RegType
+{
+    REG_UINT16,
+    REG_INT16,
+    REG_UINT32,
+    REG_INT32,
+    REG_FLOAT32,
+    REG_BOOL16
+};
+
+// Store-on-change settings of one output column (see change_filter.h). An
+// analog value is stored when it moves more than `abs` or `pct` percent of
+// the last stored value, a bool when it flips.
+struct Deadband
+{
+    bool enabled;
+    float abs;
+    float pct;
+    int32_t heartbeatMs; // stored anyway after this long, 0 = never
+    bool rawSigned;      // raw INT16 column: abs is in register units, compared signed
+    uint8_t group;       // poll group of the column's register (see Device::groupEvery)
+};
+
+// One register map line, already expanded: a single value read from `words`
+// registers at `addr` and written to output column `col`
+struct RegisterEntry
+{
+    int addr;
+    int words;
+    RegType type;
+    bool wordSwap; // 32-bit values: low word first (CDAB, DCBA)
+    bool byteSwap; // bytes swapped inside each word (BA, BADC, DCBA)
+    float scale;
+    int col;
+    Deadband band;
+    int periodMs; // how often it is polled, 0 = every poll
+};
+
+struct RegisterMap
+{
+    std::vector<RegisterEntry> analogs;
+    std::vector<RegisterEntry> bools; // one entry per BOOL16 word, col is its first bit
+};
+
+// `count` values read every `stride` registers from `addr` into consecutive
+// columns from `col`; `first` is the run's offset into its group's scale
+struct DecodeRun
+{
+    int32_t addr;
+    int32_t stride;
+    int32_t col;
+    int32_t count;
+    int32_t first;
+};
+
+// 16-bit values of one type and byte order
+struct Op16Group
+{
+    RegType type;
+    bool byteSwap;
+    bool scaled; // false when every scale is 1, scale stays empty
+    std::vector<DecodeRun> runs;
+    std::vector<float> scale;
+};
+
+// 32-bit values of one type and byte order
+struct Op32Group
+{
+    RegType type;
+    bool wordSwap;
+    bool byteSwap;
+    bool scaled;
+    std::vector<DecodeRun> runs;
+    std::vector<float> scale;
+};
+
+// Consecutive BOOL16 words unpacked MSB first into consecutive columns
+struct BoolSpan
+{
+    int32_t addr;
+    int32_t words;
+    int32_t col;
+    bool byteSwap;
+};
+
+struct DecodePlan
+{
+    int analogCols;
+    int boolCols;
+    int minAddr;
+    int maxAddr;
+    int frameWords; // register image length decode expects: maxAddr + 1 plus padding
+    std::vector<Op16Group> op16;
+    std::vector<Op32Group> op32;
+    std::vector<BoolSpan> bools;
+    std::vector<Deadband> analogBands; // per column
+    std::vector<Deadband> boolBands;
+};
+
+RegisterMap loadRegisterMap(const char *path);
+
+DecodePlan compileDecodePlan(const RegisterMap &map);
+
+// Decodes only the entries with a register in [addr, addr + nb), into the
+// same columns `full` uses; minAddr..maxAddr is every register it reads
+DecodePlan compileRangePlan(const RegisterMap &map, const DecodePlan &full, int addr, int nb);
+
+void printDecodePlan(const DecodePlan &plan);
+
+// Every register address the plan reads, ascending and without duplicates
+std::vector<int> decodedRegisters(const DecodePlan &plan);
+
+void decodeAnalog(const DecodePlan &plan, const uint16_t *c, float *out);
+
+void decodeAnalogWith(const DecodePlan &plan, const uint16_t *c, float *out, const AnalogKernels &kernels);
+
+void decodeBool(const DecodePlan &plan, const uint16_t *c, uint8_t *out);
+
+// UINT16/INT16 registers as they are, byte order fixed but neither scaled nor
+// converted; for plans holding 16-bit entries only (analog_storage "raw")
+void decodeRaw(const DecodePlan &plan, const uint16_t *c, uint16_t *out);
+
+// Bool columns 16 to a word (boolCols / 16 words), column 16 * w + j in bit
+// 15 - j of out[w]; no unpacking, each BOOL16 word is copied in PLC bit order
+void packBool(const DecodePlan &plan, const uint16_t *c, uint16_t *out);
+
+#endif // REGISTER_MAP_H
@@ -0,0 +1,303 @@
+#include <algorithm>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "spool.h"
+#include "easylogging++.h"
+
+#define SPOOL_MAGIC "DASPOOL1"
+#define SPOOL_HEADER_SIZE 4096
+#define SPOOL_RECORD_MAGIC 0x5245434fu
+#define SPOOL_RECORD_DATA 1
+#define SPOOL_RECORD_PAD 2
+
+// head and tail only ever grow; ring offsets are taken modulo capacity
+struct SpoolHeader
+{
+    char magic[8];
+    uint64_t capacity;
+    uint64_t head;
+    uint64_t tail;
+};
+
+struct SpoolRecord
+{
+    uint32_t magic;
+    uint32_t len;
+    uint32_t crc;
+    uint32_t type;
+};
+
+struct CrcTable
+{
+    uint32_t entries[256];
+};
+
+static CrcTable makeCrcTable()
+{
+    CrcTable t;
+    for (uint32_t i = 0; i < 256; ++i)
+    {
+        uint32_t c = i;
+        for (int k = 0; k < 8; ++k)
+        {
+            c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+        }
+        t.entries[i] = c;
+    }
+    return t;
+}
+
+static uint32_t crc32(const char *data, size_t len)
+{
+    // Built once, before any writer thread can read it
+    static const CrcTable crcTable = makeCrcTable();
+    uint32_t c = 0xffffffffu;
+    for (size_t i = 0; i < len; ++i)
+    {
+        c = crcTable.entries[(c ^ (uint8_t)data[i]) & 0xff] ^ (c >> 8);
+    }
+    return c ^ 0xffffffffu;
+}
+
+static uint64_t recordSize(uint32_t len)
+{
+    return (sizeof(SpoolRecord) + len + 7) & ~(uint64_t)7;
+}
+
+static void spoolError(const char *path, const char *what)
+{
+    printf("Spool %s: %s: %s\n", path, what, strerror(errno));
+    LOG(ERROR) << "Spool " << path << ": " << what << ": " << strerror(errno);
+    exit(EXIT_FAILURE);
+}
+
+// Record at the head, skipping wrap padding; NULL when empty
+static SpoolRecord *headRecord(Spool &spool)
+{
+    SpoolHeader *h = spool.hdr;
+    while (h->head != h->tail)
+    {
+        uint64_t pos = h->head % spool.capacity;
+        uint64_t left = spool.capacity - pos;
+        SpoolRecord *r = (SpoolRecord *)(spool.ring + pos);
+        if (left < sizeof(SpoolRecord) || r->type == SPOOL_RECORD_PAD)
+        {
+            h->head += left;
+            continue;
+        }
+        return r;
+    }
+    return NULL;
+}
+
+static bool validRecord(const SpoolRecord *r, uint64_t left)
+{
+    return r->magic == SPOOL_RECORD_MAGIC && r->type == SPOOL_RECORD_DATA && recordSize(r->len) <= left &&
+           crc32((const char *)(r + 1), r->len) == r->crc;
+}
+
+// Keeps the records from head up to the first one that is torn or corrupt
+static void recover(Spool &spool, const char *path)
+{
+    SpoolHeader *h = spool.hdr;
+    uint64_t off = h->head;
+    uint64_t records = 0;
+    while (off != h->tail)
+    {
+        uint64_t pos = off % spool.capacity;
+        uint64_t left = spool.capacity - pos;
+        const SpoolRecord *r = (const SpoolRecord *)(spool.ring + pos);
+        if (left < sizeof(SpoolRecord) || r->type == SPOOL_RECORD_PAD)
+        {
+            off += left;
+            continue;
+        }
+        if (off + recordSize(r->len) > h->tail || !validRecord(r, left))
+        {
+            printf("Spool %s: dropping %lu bytes after a damaged record\n", path, (unsigned long)(h->tail - off));
+            LOG(WARNING) << "Spool " << path << ": dropping " << (h->tail - off) << " bytes after a damaged record";
+            h->tail = off;
+            break;
+        }
+        off += recordSize(r->len);
+        ++records;
+    }
+    printf("Spool %s: %lu records, %lu of %lu bytes\n", path, (unsigned long)records,
+           (unsigned long)spoolUsed(spool), (unsigned long)spool.capacity);
+    LOG(INFO) << "Spool " << path << ": " << records << " records, " << spoolUsed(spool) << " of " << spool.capacity << " bytes";
+}
+
+void spoolOpen(Spool &spool, const char *path, uint64_t maxBytes, SpoolOverflow overflow)
+{
+    spool.overflow = overflow;
+    spool.fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (spool.fd < 0)
+    {
+        spoolError(path, "open");
+    }
+    struct stat st;
+    if (fstat(spool.fd, &st) != 0)
+    {
+        spoolError(path, "fstat");
+    }
+
+    // An existing spool keeps its size while it still holds records
+    uint64_t capacity = maxBytes & ~(uint64_t)7;
+    bool keep = false;
+    SpoolHeader old;
+    if ((uint64_t)st.st_size > SPOOL_HEADER_SIZE && pread(spool.fd, &old, sizeof(old), 0) == (ssize_t)sizeof(old) &&
+        memcmp(old.magic, SPOOL_MAGIC, 8) == 0 && old.capacity == (uint64_t)st.st_size - SPOOL_HEADER_SIZE &&
+        old.head <= old.tail && old.tail - old.head <= old.capacity && old.head % 8 == 0 && old.tail % 8 == 0)
+    {
+        keep = old.head != old.tail || old.capacity == capacity;
+        if (keep)
+        {
+            capacity = old.capacity;
+        }
+    }
+    if (!keep && (ftruncate(spool.fd, 0) != 0 || ftruncate(spool.fd, SPOOL_HEADER_SIZE + capacity) != 0))
+    {
+        spoolError(path, "ftruncate");
+    }
+
+    spool.capacity = capacity;
+    void *p = mmap(NULL, SPOOL_HEADER_SIZE + capacity, PROT_READ | PROT_WRITE, MAP_SHARED, spool.fd, 0);
+    if (p == MAP_FAILED)
+    {
+        spoolError(path, "mmap");
+    }
+    spool.base = (char *)p;
+    spool.hdr = (SpoolHeader *)spool.base;
+    spool.ring = spool.base + SPOOL_HEADER_SIZE;
+    if (!keep)
+    {
+        memcpy(spool.hdr->magic, SPOOL_MAGIC, 8);
+        spool.hdr->capacity = capacity;
+        spool.hdr->head = 0;
+        spool.hdr->tail = 0;
+    }
+    recover(spool, path);
+}
+
+void spoolClose(Spool &spool)
+{
+    if (spool.base != NULL)
+    {
+        msync(spool.base, SPOOL_HEADER_SIZE + spool.capacity, MS_SYNC);
+        munmap(spool.base, SPOOL_HEADER_SIZE + spool.capacity);
+        spool.base = NULL;
+    }
+    if (spool.fd >= 0)
+    {
+        close(spool.fd);
+        spool.fd = -1;
+    }
+}
+
+char *spoolReserve(Spool &spool, uint32_t len)
+{
+    SpoolHeader *h = spool.hdr;
+    uint64_t size = recordSize(len);
+    if (size > spool.capacity)
+    {
+        ++spool.dropped;
+        return NULL;
+    }
+    uint64_t pad;
+    while (1)
+    {
+        if (h->head == h->tail)
+        {
+            h->head = h->tail = 0;
+        }
+        uint64_t left = spool.capacity - h->tail % spool.capacity;
+        pad = size > left ? left : 0;
+        if (spool.capacity - (h->tail - h->head) >= pad + size)
+        {
+            break;
+        }
+        if (spool.overflow == SPOOL_DROP_NEWEST)
+        {
+            ++spool.dropped;
+            return NULL;
+        }
+        spoolPop(spool);
+        ++spool.dropped;
+    }
+
+    if (pad > 0)
+    {
+        if (pad >= sizeof(SpoolRecord))
+        {
+            SpoolRecord *r = (SpoolRecord *)(spool.ring + h->tail % spool.capacity);
+            r->magic = SPOOL_RECORD_MAGIC;
+            r->len = 0;
+            r->crc = 0;
+            r->type = SPOOL_RECORD_PAD;
+        }
+        h->tail += pad;
+    }
+    SpoolRecord *r = (SpoolRecord *)(spool.ring + h->tail % spool.capacity);
+    r->magic = SPOOL_RECORD_MAGIC;
+    r->len = len;
+    r->type = SPOOL_RECORD_DATA;
+    spool.reserved = size;
+    return (char *)(r + 1);
+}
+
+void spoolCommit(Spool &spool)
+{
+    SpoolRecord *r = (SpoolRecord *)(spool.ring + spool.hdr->tail % spool.capacity);
+    r->crc = crc32((const char *)(r + 1), r->len);
+    spool.hdr->tail += spool.reserved;
+    spool.reserved = 0;
+}
+
+const char *spoolFront(Spool &spool, uint32_t &len)
+{
+    SpoolRecord *r;
+    while ((r = headRecord(spool)) != NULL)
+    {
+        uint64_t left = spool.capacity - spool.hdr->head % spool.capacity;
+        if (validRecord(r, left))
+        {
+            len = r->len;
+            return (const char *)(r + 1);
+        }
+        printf("Spool: skipping a damaged record\n");
+        LOG(WARNING) << "Spool: skipping a damaged record";
+        if (r->magic != SPOOL_RECORD_MAGIC || recordSize(r->len) > left)
+        {
+            // Nothing to say where the next record starts
+            spool.hdr->head = spool.hdr->tail;
+            return NULL;
+        }
+        spool.hdr->head += recordSize(r->len);
+    }
+    return NULL;
+}
+
+void spoolPop(Spool &spool)
+{
+    SpoolRecord *r = headRecord(spool);
+    if (r != NULL)
+    {
+        spool.hdr->head = std::min(spool.hdr->head + recordSize(r->len), spool.hdr->tail);
+    }
+}
+
+bool spoolEmpty(const Spool &spool)
+{
+    return spool.hdr->head == spool.hdr->tail;
+}
+
+uint64_t spoolUsed(const Spool &spool)
+{
+    return spool.hdr->tail - spool.hdr->head;
+}
@@ -0,0 +1,58 @@
+#ifndef SPOOL_H
+#define SPOOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define DEFAULT_SPOOL_DIR "spool"
+#define DEFAULT_SPOOL_MAX_BYTES (256L << 20)
+
+// What a full spool does with another record
+enum SpoolOverflow
+{
+    SPOOL_DROP_OLDEST,
+    SPOOL_DROP_NEWEST
+};
+
+struct SpoolHeader;
+
+// Append-only record log in a memory-mapped file, used as a ring: records are
+// written at the tail and consumed from the head. Each record carries a CRC,
+// so a torn tail after a crash is found and cut off when the file is opened.
+// Not thread-safe; one writer thread owns a spool.
+struct Spool
+{
+    int fd = -1;
+    char *base = NULL;
+    SpoolHeader *hdr = NULL;
+    char *ring = NULL;
+    uint64_t capacity = 0;
+    SpoolOverflow overflow = SPOOL_DROP_OLDEST;
+    uint64_t dropped = 0; // records lost to overflow
+    uint64_t reserved = 0; // size of the record being written
+};
+
+// Opens or creates `path` holding up to `maxBytes` of records and recovers
+// whatever intact records it still has. Exits on I/O errors.
+void spoolOpen(Spool &spool, const char *path, uint64_t maxBytes, SpoolOverflow overflow);
+
+void spoolClose(Spool &spool);
+
+// Room for a `len`-byte record at the tail, NULL if it does not fit (after
+// dropping the oldest records if the policy allows). Nothing is visible to
+// readers until spoolCommit.
+char *spoolReserve(Spool &spool, uint32_t len);
+
+void spoolCommit(Spool &spool);
+
+// Oldest record, NULL when empty. Records failing their CRC are skipped.
+const char *spoolFront(Spool &spool, uint32_t &len);
+
+void spoolPop(Spool &spool);
+
+bool spoolEmpty(const Spool &spool);
+
+// Bytes held, including record headers
+uint64_t spoolUsed(const Spool &spool);
+
+#endif // SPOOL_H
@@ -0,0 +1,125 @@
+#include "taos_stub.h"
+
+static uint64_t rowsBound;
+static int handle; // any non-NULL pointer will do
+static int executeError;
+static int executeFailures;
+
+uint64_t taosStubRowsBound()
+{
+    return rowsBound;
+}
+
+void taosStubFailExecute(int code, int calls)
+{
+    executeError = code;
+    executeFailures = calls;
+}
+
+extern "C" {
+
+TAOS *taos_connect(const char *, const char *, const char *, const char *, uint16_t)
+{
+    return &handle;
+}
+
+void taos_close(TAOS *)
+{
+}
+
+void taos_cleanup(void)
+{
+}
+
+TAOS_RES *taos_query(TAOS *, const char *)
+{
+    return &handle;
+}
+
+int taos_errno(TAOS_RES *)
+{
+    return 0;
+}
+
+const char *taos_errstr(TAOS_RES *)
+{
+    return "";
+}
+
+void taos_free_result(TAOS_RES *)
+{
+}
+
+int taos_affected_rows(TAOS_RES *)
+{
+    return 0;
+}
+
+int taos_num_fields(TAOS_RES *)
+{
+    return 0;
+}
+
+TAOS_FIELD *taos_fetch_fields(TAOS_RES *)
+{
+    return NULL;
+}
+
+TAOS_ROW taos_fetch_row(TAOS_RES *)
+{
+    return NULL;
+}
+
+TAOS_STMT *taos_stmt_init(TAOS *)
+{
+    return &handle;
+}
+
+int taos_stmt_prepare(TAOS_STMT *, const char *, unsigned long)
+{
+    return 0;
+}
+
+int taos_stmt_set_tbname_tags(TAOS_STMT *, const char *, TAOS_MULTI_BIND *)
+{
+    return 0;
+}
+
+int taos_stmt_bind_param_batch(TAOS_STMT *, TAOS_MULTI_BIND *bind)
+{
+    rowsBound += bind[0].num;
+    return 0;
+}
+
+int taos_stmt_add_batch(TAOS_STMT *)
+{
+    return 0;
+}
+
+int taos_stmt_execute(TAOS_STMT *)
+{
+    if (executeFailures > 0)
+    {
+        --executeFailures;
+        return executeError;
+    }
+    return 0;
+}
+
+TAOS_RES *taos_schemaless_insert(TAOS *, char *[], int numLines, int, int)
+{
+    rowsBound += numLines;
+    return &handle;
+}
+
+char *taos_stmt_errstr(TAOS_STMT *)
+{
+    return (char *)"";
+}
+
+int taos_stmt_close(TAOS_STMT *)
+{
+    return 0;
+}
+
+}
@@ -0,0 +1,20 @@
+#ifndef TAOS_STUB_H
+#define TAOS_STUB_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "taos.h"
+
+// A TDengine client that talks to nothing, linked by the benchmarks instead
+// of -ltaos: every call succeeds at once, so only our side of it is timed.
+// Queries return no rows.
+
+// Rows bound with taos_stmt_bind_param_batch or sent to taos_schemaless_insert
+// so far, every column counted once
+uint64_t taosStubRowsBound();
+
+// Has the next `calls` taos_stmt_execute fail with `code`, e.g. a TDengine
+// that refuses the rows or has gone away
+void taosStubFailExecute(int code, int calls);
+
+#endif // TAOS_STUB_H
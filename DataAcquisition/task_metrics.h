@@ -0,0 +1,32 @@
+#ifndef TASK_METRICS_H
+#define TASK_METRICS_H
+
+#include <taskflow/taskflow.hpp>
+#include "metrics.h"
+
+// Records how long every task of an executor runs in the histogram
+// task_<task name>: executor.make_observer<TaskMetrics>(). The histogram is
+// looked up by name on each run, which is fine at task granularity.
+class TaskMetrics : public tf::ObserverInterface
+{
+public:
+    void set_up(size_t workers) override
+    {
+        starts.assign(workers, 0);
+    }
+
+    void on_entry(tf::WorkerView w, tf::TaskView) override
+    {
+        starts[w.id()] = metricsNowNs();
+    }
+
+    void on_exit(tf::WorkerView w, tf::TaskView t) override
+    {
+        metricHistogram("task_" + t.name()).record(metricsNowNs() - starts[w.id()]);
+    }
+
+private:
+    std::vector<int64_t> starts; // per worker, each only touched by its own
+};
+
+#endif // TASK_METRICS_H
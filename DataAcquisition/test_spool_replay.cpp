@@ -0,0 +1,113 @@
+// Spool replay against a stubbed TDengine (taos_stub.cpp) told to fail chosen
+// inserts: a batch TDengine refuses is dropped, from the spool or when it is
+// flushed, and the rows behind it still go in; one that finds the server
+// gone stays spooled until the writer is back. Exits non-zero at the first
+// check that fails.
+//
+//   ./test_spool_replay [register_map.json]
+#include <unistd.h>
+#include "gVal.h"
+#include "device.h"
+#include "myTaos.h"
+#include "data_acquisition_save.h"
+#include "taos_stub.h"
+
+#define TEST_SPOOL_PATH "test_spool_replay.spool"
+#define TEST_ROWS 10
+// TSDB_CODE_PAR_TABLE_NOT_EXIST: TDengine refuses the rows
+#define TEST_CODE_REFUSED ((int)0x80002603u)
+// TSDB_CODE_RPC_NETWORK_UNAVAIL: TDengine cannot be reached
+#define TEST_CODE_UNREACHABLE ((int)0x8000000Bu)
+
+static int failures = 0;
+
+static void check(bool ok, const char *what)
+{
+    printf("  %-52s %s\n", what, ok ? "ok" : "FAILED");
+    if (!ok)
+    {
+        ++failures;
+    }
+}
+
+static void addRows(Device &d, int64_t &ts)
+{
+    for (int r = 0; r < TEST_ROWS; ++r)
+    {
+        ts += 100;
+        d.analogs.commit(ts);
+    }
+}
+
+static void reconnect(WriterShard &shard)
+{
+    shard.conn = taosTryConnect("127.0.0.1", "root", "taosdata", "test", 6030);
+}
+
+int main(int argc, char *argv[])
+{
+    const char *mapPath = argc > 1 ? argv[1] : DEFAULT_REGISTER_MAP;
+    json config_data = {{"devices", {{{"ip", "127.0.0.1"}, {"port", 502}, {"slave", 1}, {"register_map", mapPath}}}}};
+    std::vector<Device> devices = loadDevices(config_data, 1, DEVICE_FRAME_SLOTS, TEST_ROWS, DEFAULT_POLL_PERIOD_MS);
+    Device &d = devices[0];
+
+    WriterShard shard;
+    shard.id = 0;
+    shard.conn = NULL;
+    shard.retryMs = 0;
+    shard.retryAt = 0;
+    shard.lostBatches = 0;
+    shard.rejectedBatches = 0;
+    shard.rows = TEST_ROWS;
+    shard.devices.push_back(0);
+    sem_init(&shard.ready, 0, 0);
+    unlink(TEST_SPOOL_PATH);
+    spoolOpen(shard.spool, TEST_SPOOL_PATH, 1 << 20, SPOOL_DROP_OLDEST);
+    int64_t ts = writerWallMs();
+
+    puts("refused while replaying");
+    addRows(d, ts);
+    flushDevice(shard, d);
+    addRows(d, ts);
+    flushDevice(shard, d);
+    check(spoolPending(shard), "rows spooled while TDengine is down");
+    reconnect(shard);
+    taosStubFailExecute(TEST_CODE_REFUSED, 1);
+    uint64_t bound = taosStubRowsBound();
+    replaySpool(shard, devices);
+    check(!spoolPending(shard), "spool drained past the refused batch");
+    check(shard.rejectedBatches == 1, "refused batch counted");
+    check(shard.conn != NULL, "writer stays connected");
+    check(taosStubRowsBound() > bound, "batch behind it inserted");
+
+    puts("refused when flushed");
+    addRows(d, ts);
+    taosStubFailExecute(TEST_CODE_REFUSED, 1);
+    flushDevice(shard, d);
+    check(!spoolPending(shard), "refused batch not spooled");
+    check(shard.rejectedBatches == 2, "refused batch counted");
+    addRows(d, ts);
+    bound = taosStubRowsBound();
+    flushDevice(shard, d);
+    check(!spoolPending(shard) && taosStubRowsBound() > bound, "next batch inserted directly");
+
+    puts("unreachable while replaying");
+    taos_close(shard.conn);
+    shard.conn = NULL;
+    addRows(d, ts);
+    flushDevice(shard, d);
+    reconnect(shard);
+    taosStubFailExecute(TEST_CODE_UNREACHABLE, 1);
+    replaySpool(shard, devices);
+    check(shard.conn == NULL, "writer taken down");
+    check(spoolPending(shard), "batch kept in the spool");
+    check(shard.rejectedBatches == 2, "nothing counted as refused");
+    reconnect(shard);
+    replaySpool(shard, devices);
+    check(!spoolPending(shard), "spool replayed once TDengine is back");
+
+    spoolClose(shard.spool);
+    unlink(TEST_SPOOL_PATH);
+    printf("%s\n", failures == 0 ? "all checks passed" : "checks failed");
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}